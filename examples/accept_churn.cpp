@@ -0,0 +1,104 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-pool>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+using namespace asr;
+using namespace std;
+
+int num_connections = 20000;
+int num_clients = 4;
+
+/**
+ * Opens short lived connections: connects, waits for the server to close and closes.
+ */
+void client (int port, atomic<int> *remaining)
+{
+    ptr<SockAddr> addr = new SockAddrIP4("127.0.0.1", port);
+    char buffer[64];
+
+    while ((*remaining)-- > 0)
+    {
+        SocketTCP socket;
+        if (!socket.connect(addr))
+            continue;
+
+        socket.is_readable(1000);
+        socket.recv(buffer, sizeof(buffer));
+    }
+}
+
+/**
+ * Accepts connections in batches and closes them right away, with or without recycling the socket objects.
+ */
+void bench (bool pooled)
+{
+    SocketTCP listener;
+    listener.bind(new SockAddrIP4("127.0.0.1", 0));
+    listener.listen(4096);
+
+    SocketPool pool;
+    vector<ptr<SocketTCP>> accepted;
+    int count = 0, batches = 0;
+    long blocks = 0;
+
+    atomic<int> remaining (num_connections);
+    vector<thread> threads;
+    for (int i = 0; i < num_clients; i++)
+        threads.emplace_back(client, ((SockAddrIP4 *)listener.local.get())->get_port(), &remaining);
+
+    // Only the time spent accepting is measured, the clients run on the same cores.
+    chrono::steady_clock::duration elapsed {};
+    while (count < num_connections)
+    {
+        if (!listener.is_readable(1000))
+            break;
+
+        auto t0 = chrono::steady_clock::now();
+        uint32_t m = asr::memblocks;
+        int n = listener.accept(accepted, 64, pooled ? &pool : nullptr);
+        blocks += (int32_t)(asr::memblocks - m);
+        elapsed += chrono::steady_clock::now() - t0;
+        if (n > 0) batches++;
+
+        for (auto& socket : accepted)
+            socket->close();
+
+        accepted.clear();
+        count += n;
+    }
+
+    for (auto& i : threads)
+        i.join();
+
+    double ns = chrono::duration<double, nano>(elapsed).count();
+    cout << (pooled ? "pooled  " : "unpooled") << ": " << (int)(ns / count) << " ns per accept, "
+         << (double)blocks / (count ? count : 1) << " blocks allocated per accept, "
+         << (double)count / (batches ? batches : 1) << " per batch";
+    if (pooled)
+        cout << ", " << pool.get_created() << " objects created, " << pool.get_recycled() << " recycled";
+    cout << endl;
+}
+
+/**
+ * Usage: accept_churn [connections] [clients]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_connections = atoi(argv[1]);
+    if (argc > 2) num_clients = atoi(argv[2]);
+
+    auto n = asr::memblocks;
+
+    bench(false);
+    bench(true);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-udp>
+#include <asr/reactor>
+#include <asr/latency-histogram>
+#include <iostream>
+#include <thread>
+#include <atomic>
+
+using namespace asr;
+using namespace std;
+
+int num_pings = 20000;
+int spin_budget = 200;
+
+/**
+ * Echoes every datagram waiting on the socket.
+ */
+void on_ping (Socket *socket, int events, void *data)
+{
+    SocketUDP *udp = (SocketUDP *)socket;
+    char buffer[64];
+
+    int n;
+    while ((n = udp->recv(buffer, sizeof(buffer))) > 0)
+        udp->send(buffer, n);
+}
+
+/**
+ * Measures round trips to an echo server whose reactor spins for `spin` microseconds before each blocking wait.
+ */
+void bench (int spin)
+{
+    SocketUDP server (new SockAddrIP4("127.0.0.1", 0));
+    server.set_busy_poll(spin);
+
+    Reactor reactor;
+    reactor.spin_budget = spin;
+    reactor.add(&server, EV_READ, on_ping);
+
+    atomic<bool> stop (false);
+    thread loop ([&]() {
+        while (!stop)
+            reactor.poll(100);
+    });
+
+    SocketUDP client (new SockAddrIP4("127.0.0.1", 0));
+    client.remote = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)server.local.get())->get_port());
+
+    // The client waits a little between pings, as a gateway between bursts, so the server goes idle each time.
+    LatencyHistogram rtt;
+    char ping[32] = {0}, pong[64];
+    int lost = 0;
+
+    for (int i = 0; i < num_pings; i++)
+    {
+        int64_t t0 = LatencyTrace::now();
+        client.send(ping, sizeof(ping));
+
+        if (!client.is_readable(1000) || client.recv(pong, sizeof(pong)) <= 0) {
+            lost++;
+            continue;
+        }
+
+        rtt.record(LatencyTrace::now() - t0);
+
+        int64_t pause = LatencyTrace::now() + 20000;
+        while (LatencyTrace::now() < pause) { }
+    }
+
+    stop = true;
+    loop.join();
+    reactor.remove(&server);
+
+    const ReactorStats& stats = reactor.stats();
+    cout << (spin ? "spin    : " : "blocking: ");
+    rtt.dump(cout);
+    cout << (lost ? " \e[91m(lost pings)\e[0m" : "") << endl;
+    cout << "          " << (int)(stats.spin_ratio() * 100) << "% spinning, " << (int)(stats.idle_ratio() * 100) << "% idle, "
+         << (int)(stats.spin_hit_ratio() * 100) << "% of the polls woken while spinning, " << stats.sleeps << " sleeps" << endl;
+}
+
+/**
+ * Usage: busy_poll [pings] [spin-microseconds]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_pings = atoi(argv[1]);
+    if (argc > 2) spin_budget = atoi(argv[2]);
+
+    if (thread::hardware_concurrency() < 2)
+        cout << "\e[90mSingle CPU: the spinning server competes with the client for the core\e[0m" << endl;
+
+    auto n = asr::memblocks;
+
+    bench(0);
+    bench(spin_budget);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
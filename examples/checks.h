@@ -0,0 +1,33 @@
+#ifndef __EXAMPLES_CHECKS_H
+#define __EXAMPLES_CHECKS_H
+
+#include <iostream>
+
+/**
+ * Self-checking examples: each `check` prints its result and `checks_summary` reports the failures at the end.
+ */
+inline int num_checks = 0;
+inline int num_failures = 0;
+
+/**
+ * Prints the result of a check.
+ */
+inline void check (const char *name, bool passed)
+{
+    std::cout << (passed ? "\e[32m  ok  \e[0m" : "\e[91m FAIL \e[0m") << name << std::endl;
+    num_failures += !passed;
+    num_checks++;
+}
+
+/**
+ * Prints how many checks failed, returns the exit status of the example.
+ */
+inline int checks_summary()
+{
+    if (num_failures)
+        std::cout << "\e[91m" << num_failures << " of " << num_checks << " checks failed\e[0m" << std::endl;
+
+    return num_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include <asr/socket-addr-ip4>
+#include <asr/connector>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <sys/resource.h>
+
+using namespace asr;
+using namespace std;
+
+int num_connections = 500;
+
+/**
+ * Server side of the test: accepts connections and counts the bytes of the payloads received.
+ */
+struct Server
+{
+    Reactor *reactor;
+    SocketTCP listener;
+    unordered_map<SOCKET, ptr<SocketTCP>> clients;
+    vector<ptr<SocketTCP>> accepted;
+    int received = 0;
+};
+
+/**
+ * Client side: connections being opened and results.
+ */
+struct Client
+{
+    Reactor *reactor;
+    vector<ptr<SocketTCP>> sockets;
+    int connected = 0;
+    int failed = 0;
+};
+
+/**
+ */
+void on_server_data (Socket *socket, int events, void *data)
+{
+    Server *server = (Server *)data;
+    char buffer[256];
+    int n;
+
+    while ((n = ((SocketTCP *)socket)->recv(buffer, sizeof(buffer))) > 0)
+        server->received += n;
+
+    if (events & (EV_HANGUP | EV_ERROR)) {
+        server->reactor->remove(socket);
+        server->clients.erase(socket->socket);
+    }
+}
+
+/**
+ */
+void on_server_accept (Socket *socket, int events, void *data)
+{
+    Server *server = (Server *)data;
+
+    while (server->listener.accept(server->accepted) > 0)
+    {
+        for (auto& client : server->accepted) {
+            server->reactor->add(client.get(), EV_READ, on_server_data, server);
+            server->clients[client->socket] = client;
+        }
+
+        server->accepted.clear();
+    }
+}
+
+/**
+ */
+void on_client_event (Socket *socket, int events, void *data)
+{
+    if (events & (EV_HANGUP | EV_ERROR))
+        ((Client *)data)->reactor->remove(socket);
+}
+
+/**
+ */
+void on_connect (SocketTCP *socket, bool connected, void *data)
+{
+    Client *client = (Client *)data;
+    if (!connected) {
+        client->failed++;
+        return;
+    }
+
+    // Registered again so the reactor flushes the rest of the payload, if any is still queued.
+    client->connected++;
+    client->reactor->add(socket, 0, on_client_event, client);
+}
+
+/**
+ */
+void test()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    Reactor reactor;
+    Server server;
+    server.reactor = &reactor;
+
+    server.listener.bind(new SockAddrIP4("127.0.0.1", 0));
+    bool fastopen = server.listener.set_fastopen();
+    server.listener.listen(4096);
+    reactor.add(&server.listener, EV_READ, on_server_accept, &server);
+
+    ptr<SockAddr> addr = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)server.listener.local.get())->get_port());
+    const char payload[] = "hello";
+
+    // One blocking connect after the other.
+    {
+        Client client;
+        client.reactor = &reactor;
+
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < num_connections; i++) {
+            ptr<SocketTCP> socket = new SocketTCP();
+            if (socket->connect(addr)) client.connected++; else client.failed++;
+            client.sockets.push_back(socket);
+            reactor.poll(0);
+        }
+
+        auto t1 = chrono::steady_clock::now();
+        cout << "blocking : " << client.connected << " connected in "
+             << chrono::duration<double, milli>(t1 - t0).count() << " ms" << endl;
+
+        while (reactor.poll(10) > 0);
+    }
+
+    // All attempts in flight at once, each one sending a payload (with the SYN when Fast Open is available).
+    {
+        Client client;
+        client.reactor = &reactor;
+        Connector connector (&reactor);
+
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < num_connections; i++) {
+            ptr<SocketTCP> socket = new SocketTCP();
+            if (!connector.connect(socket.get(), addr, on_connect, &client, 2000, payload, sizeof(payload)))
+                client.failed++;
+            client.sockets.push_back(socket);
+        }
+
+        while (connector.size())
+            reactor.poll(100);
+
+        auto t1 = chrono::steady_clock::now();
+
+        while (server.received < client.connected * (int)sizeof(payload) && reactor.poll(100) > 0);
+
+        cout << "connector: " << client.connected << " connected in "
+             << chrono::duration<double, milli>(t1 - t0).count() << " ms, " << server.received << " payload bytes received"
+             << (fastopen ? " (fast open enabled)" : "") << endl;
+
+        for (auto& socket : client.sockets)
+            reactor.remove(socket.get());
+    }
+
+    // Attempts that can not complete in time (the listener never accepts and its backlog is full).
+    {
+        SocketTCP listener;
+        listener.bind(new SockAddrIP4("127.0.0.1", 0));
+        listener.listen(0);
+        ptr<SockAddr> full = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)listener.local.get())->get_port());
+
+        Client client;
+        client.reactor = &reactor;
+        Connector connector (&reactor);
+
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < 16; i++) {
+            ptr<SocketTCP> socket = new SocketTCP();
+            connector.connect(socket.get(), full, on_connect, &client, 300);
+            client.sockets.push_back(socket);
+        }
+
+        while (connector.size())
+            reactor.poll(100);
+
+        auto t1 = chrono::steady_clock::now();
+        cout << "timeouts : " << client.connected << " connected, " << client.failed << " failed after "
+             << chrono::duration<double, milli>(t1 - t0).count() << " ms" << endl;
+
+        for (auto& socket : client.sockets)
+            reactor.remove(socket.get());
+    }
+
+    reactor.remove(&server.listener);
+    for (auto& i : server.clients)
+        reactor.remove(i.second.get());
+}
+
+/**
+ * Usage: connect_storm [connections]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_connections = atoi(argv[1]);
+
+    auto n = asr::memblocks;
+
+    test();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include <asr/data-schema-reader>
+#include <iostream>
+#include <cstring>
+
+#include "checks.h"
+
+using namespace asr;
+using namespace std;
+
+/**
+ * Encodes an object with a schema, returns `false` if the schema rejected it.
+ */
+template<typename T>
+bool encode (DataSchema<T> &schema, T *object, Buffer *output)
+{
+    int state[16] = {0};
+    try {
+        auto *field = schema.root;
+        while (field != nullptr)
+            field = field->write(output, object, state);
+    }
+    catch (Error &e) {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Returns `true` if the buffer holds exactly the given bytes.
+ */
+bool holds (Buffer &buffer, const unsigned char *bytes, int length)
+{
+    if (buffer.bytes_available() != length)
+        return false;
+
+    char data[64];
+    buffer.drain(data, length, false);
+    return memcmp(data, bytes, length) == 0;
+}
+
+/**
+ * Frame header with packed flags, the layout of the first two bytes of a WebSocket frame followed by a payload
+ * selected by the opcode bit-field.
+ */
+class Frame
+{
+    public:
+
+    unsigned int fin = 0;
+    unsigned int rsv = 0;
+    unsigned int opcode = 0;
+    unsigned int masked = 0;
+    unsigned int length = 0;
+    unsigned int code = 0;
+    unsigned int ping = 0;
+    unsigned int raw = 0;
+    unsigned int low = 0;
+    unsigned int high = 0;
+};
+
+DataSchema<Frame> *frame_schema()
+{
+    auto *schema = new DataSchema<Frame>();
+    schema
+        ->word16be()
+        ->bits(&Frame::fin, 15, 1)
+        ->bits(&Frame::rsv, 12, 3)
+            ->throws(1, "reserved bits set")
+            ->when(0)->end()
+        ->bits(&Frame::opcode, 8, 4)
+            ->throws(2, "unsupported opcode")
+            ->when(8)
+                ->uint16be(&Frame::code)
+            ->end()
+            ->when(9)
+                // Packed word inside a conditional block.
+                ->word8()
+                ->bits(&Frame::ping, 0, 7)
+            ->end()
+        ->bits(&Frame::masked, 7, 1)
+        ->bits(&Frame::length, 0, 7)
+        ->word32(&Frame::raw)
+        ->bits(&Frame::low, 0, 16)
+        ->bits(&Frame::high, 16, 16)
+    ;
+
+    return schema;
+}
+
+/**
+ * Writes frames and checks their bytes, then reads them back.
+ */
+void test_round_trip()
+{
+    DataSchema<Frame> *schema = frame_schema();
+    Buffer buffer;
+
+    // Close frame: FIN, opcode 8, masked, length 2, code 1000, then a little endian word.
+    Frame close;
+    close.fin = 1;
+    close.opcode = 8;
+    close.masked = 1;
+    close.length = 2;
+    close.code = 1000;
+    close.low = 0xBEEF;
+    close.high = 0xCAFE;
+
+    const unsigned char close_bytes[] = { 0x88, 0x82, 0x03, 0xE8, 0xEF, 0xBE, 0xFE, 0xCA };
+    check("write packs bit-fields into a big endian word", encode(*schema, &close, &buffer) && holds(buffer, close_bytes, sizeof(close_bytes)));
+
+    DataSchemaReader<Frame> reader (schema, &buffer);
+    auto frame = reader.feed();
+    check("read extracts every bit-field", frame != nullptr && frame->fin == 1 && frame->rsv == 0 && frame->opcode == 8
+        && frame->masked == 1 && frame->length == 2 && frame->code == 1000);
+    check("read stores the raw word and its bit-fields", frame != nullptr && frame->raw == 0xCAFEBEEF && frame->low == 0xBEEF && frame->high == 0xCAFE);
+    check("read consumes the whole frame", buffer.bytes_available() == 0);
+
+    // Ping frame: the opcode selects the packed word of the conditional block.
+    Frame ping;
+    ping.opcode = 9;
+    ping.ping = 0x55;
+    ping.length = 127;
+
+    const unsigned char ping_bytes[] = { 0x09, 0x7F, 0x55, 0, 0, 0, 0 };
+    check("bit-field selects a conditional block on write", encode(*schema, &ping, &buffer) && holds(buffer, ping_bytes, sizeof(ping_bytes)));
+
+    frame = reader.feed();
+    check("bit-field selects a conditional block on read", frame != nullptr && frame->opcode == 9 && frame->ping == 0x55 && frame->length == 127 && frame->code == 0);
+
+    // Values wider than their bit-field are truncated to it.
+    Frame wide = close;
+    wide.length = 0x1FF;
+    encode(*schema, &wide, &buffer);
+    frame = reader.feed();
+    check("write truncates values to the bit-field width", frame != nullptr && frame->length == 0x7F && frame->masked == 1);
+
+    // A bit-field condition rejects the frame.
+    const unsigned char reserved[] = { 0xC1, 0x00, 0, 0, 0, 0 };
+    buffer.write((char *)reserved, sizeof(reserved));
+
+    int code = 0;
+    try {
+        reader.feed();
+    }
+    catch (Error &e) {
+        code = e.code();
+    }
+    check("bit-field condition rejects the frame on read", code == 1);
+
+    Frame unsupported = close;
+    unsupported.opcode = 3;
+    check("bit-field condition rejects the object on write", !encode(*schema, &unsupported, &buffer));
+
+    delete schema;
+}
+
+/**
+ * Bit-fields must follow a packed word (or another bit-field of it) and fit in it.
+ */
+void test_declaration()
+{
+    auto throws = [](auto build) {
+        DataSchema<Frame> schema;
+        try {
+            build(&schema);
+        }
+        catch (Error &e) {
+            return true;
+        }
+        return false;
+    };
+
+    check("bits() on an empty schema throws", throws([](DataSchema<Frame> *s) {
+        s->bits(&Frame::fin, 0, 1);
+    }));
+
+    check("bits() after a plain integer throws", throws([](DataSchema<Frame> *s) {
+        s->uint16be(&Frame::code)->bits(&Frame::fin, 0, 1);
+    }));
+
+    check("bits() first in a conditional block throws", throws([](DataSchema<Frame> *s) {
+        s->word8()->bits(&Frame::opcode, 0, 4)->when(1)->bits(&Frame::fin, 4, 1);
+    }));
+
+    check("bits() past the end of the word throws", throws([](DataSchema<Frame> *s) {
+        s->word8()->bits(&Frame::fin, 4, 5);
+    }));
+
+    check("when() on a word not bound to a member throws", throws([](DataSchema<Frame> *s) {
+        s->word8()->when(1);
+    }));
+
+    check("when() on a word bound to a member is accepted", !throws([](DataSchema<Frame> *s) {
+        s->word8(&Frame::raw)->when(1)->end();
+    }));
+
+    check("bits() after a word and its bit-fields is accepted", !throws([](DataSchema<Frame> *s) {
+        s->word16()->bits(&Frame::fin, 0, 1)->bits(&Frame::opcode, 1, 4)->when(1)->end()->bits(&Frame::length, 5, 11);
+    }));
+}
+
+/**
+ */
+int main (int argc, const char *argv[])
+{
+    auto n = asr::memblocks;
+
+    test_round_trip();
+    test_declaration();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return checks_summary();
+}
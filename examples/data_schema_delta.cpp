@@ -0,0 +1,209 @@
+#include <asr/data-schema-delta>
+#include <iostream>
+#include <cstring>
+
+#include "checks.h"
+
+using namespace asr;
+using namespace std;
+
+/**
+ * Market data update, most updates change only the price and the volume.
+ */
+class Quote
+{
+    public:
+
+    unsigned int symbol = 0;
+    int price = 0;
+    unsigned int volume = 0;
+    unsigned int side = 0;
+    unsigned int flags = 0;
+    int64_t time = 0;
+    double average = 0;
+};
+
+bool operator== (const Quote &a, const Quote &b) {
+    return a.symbol == b.symbol && a.price == b.price && a.volume == b.volume && a.side == b.side && a.flags == b.flags
+        && a.time == b.time && a.average == b.average;
+}
+
+const int NUM_FIELDS = 6;
+const int BITMAP_SIZE = 1;
+const int RECORD_SIZE = 4 + 4 + 4 + 1 + 8 + 8;
+
+void build (DataSchema<Quote> &schema)
+{
+    schema
+        .uint32be(&Quote::symbol)
+        ->int32be(&Quote::price)
+        ->uint32be(&Quote::volume)
+        ->word8()
+        ->bits(&Quote::side, 0, 1)
+        ->bits(&Quote::flags, 1, 7)
+        ->int64be(&Quote::time)
+        ->float64be(&Quote::average)
+    ;
+}
+
+/**
+ * Writes a stream of quotes where each changes a few fields of the previous one, and applies them on the reader.
+ */
+void test_stream()
+{
+    DataSchema<Quote> schema;
+    build(schema);
+
+    Buffer buffer;
+    DataSchemaDeltaWriter<Quote> writer (&schema);
+    DataSchemaDeltaReader<Quote> reader (&schema, &buffer);
+
+    Quote quote;
+    quote.symbol = 0x41424344;
+    quote.price = -1250;
+    quote.volume = 100;
+    quote.side = 1;
+    quote.flags = 0x55;
+    quote.time = 1700000000000000000LL;
+    quote.average = 12.5;
+
+    // The first record carries every field, even those still at their default value.
+    writer.write(&buffer, &quote);
+
+    unsigned char bitmap = buffer.read_uint8(true);
+    check("first record sets every field in the bitmap", bitmap == (1 << NUM_FIELDS) - 1);
+    check("first record carries every value", buffer.bytes_available() == BITMAP_SIZE + RECORD_SIZE);
+    check("reader applies the first record", reader.feed() == NUM_FIELDS && reader.object == quote);
+
+    // An unchanged record is just the empty bitmap.
+    writer.write(&buffer, &quote);
+    check("unchanged record is encoded as the header only", buffer.bytes_available() == BITMAP_SIZE && buffer.read_uint8(true) == 0);
+    check("reader applies the unchanged record", reader.feed() == 0 && reader.object == quote && buffer.bytes_available() == 0);
+
+    // Changing records, written in bulk and applied in order.
+    int total_bytes = 0, total_fields = 0;
+    bool applied = true;
+
+    Quote expected[64];
+    for (int i = 0; i < 64; i++)
+    {
+        quote.price += (i % 3) - 1;
+        if (i % 2) quote.volume += 10;
+        if (i % 8 == 0) quote.side ^= 1;
+        if (i % 16 == 0) quote.flags = i;
+        quote.time += 1000;
+
+        expected[i] = quote;
+        writer.write(&buffer, &quote);
+    }
+
+    total_bytes = buffer.bytes_available();
+
+    for (int i = 0; i < 64; i++)
+    {
+        int n = reader.feed();
+        applied &= n > 0 && reader.object == expected[i];
+        total_fields += n;
+    }
+
+    check("reader follows a changing stream", applied && buffer.bytes_available() == 0);
+    check("changing stream is smaller than full records", total_bytes < 64 * RECORD_SIZE);
+    cout << "        64 records in " << total_bytes << " bytes (" << 64 * RECORD_SIZE << " as full records), "
+         << total_fields << " fields sent" << endl;
+
+    // A reset writer sends a full record again.
+    writer.reset();
+    writer.write(&buffer, &quote);
+    check("reset writer sends a full record", reader.feed() == NUM_FIELDS && reader.object == quote);
+}
+
+/**
+ * A reader joining a stream late must not apply deltas to an object it never received in full.
+ */
+void test_sync()
+{
+    DataSchema<Quote> schema;
+    build(schema);
+
+    Buffer stream, late;
+    DataSchemaDeltaWriter<Quote> writer (&schema);
+
+    Quote quote;
+    quote.price = 10;
+    writer.write(&stream, &quote);
+
+    // The late reader sees only the deltas after the first record.
+    quote.price = 11;
+    writer.write(&late, &quote);
+    quote.volume = 5;
+    writer.write(&late, &quote);
+
+    DataSchemaDeltaReader<Quote> reader (&schema, &late);
+
+    int rejected = 0;
+    while (late.bytes_available())
+    {
+        try {
+            reader.feed();
+        }
+        catch (Error &e) {
+            rejected++;
+        }
+    }
+
+    check("reader rejects deltas before a full record", rejected == 2);
+    check("rejected deltas are not applied", reader.object.price == 0 && reader.object.volume == 0);
+
+    // Once the writer is reset the reader catches up.
+    writer.reset();
+    writer.write(&late, &quote);
+    check("reader syncs on the next full record", reader.feed() == NUM_FIELDS && reader.object == quote);
+
+    quote.price = 12;
+    writer.write(&late, &quote);
+    check("reader applies deltas once synced", reader.feed() == 1 && reader.object == quote);
+
+    // A reset reader waits for a full record again.
+    reader.reset();
+    quote.price = 13;
+    writer.write(&late, &quote);
+
+    bool thrown = false;
+    try {
+        reader.feed();
+    }
+    catch (Error &e) {
+        thrown = true;
+    }
+
+    check("reset reader rejects deltas", thrown && reader.object.price == 12 && late.bytes_available() == 0);
+
+    // Incomplete messages are left in the buffer, synced or not.
+    stream.drain(stream.bytes_available());
+    writer.reset();
+    writer.write(&stream, &quote);
+
+    char data[64];
+    int n = stream.drain(data, stream.bytes_available());
+    late.write(data, n - 1);
+    check("incomplete record is not consumed", reader.feed() == -1 && late.bytes_available() == n - 1);
+
+    late.write(data + n - 1, 1);
+    check("completed record is applied", reader.feed() == NUM_FIELDS && reader.object == quote);
+}
+
+/**
+ */
+int main (int argc, const char *argv[])
+{
+    auto n = asr::memblocks;
+
+    test_stream();
+    test_sync();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return checks_summary();
+}
@@ -0,0 +1,221 @@
+#include <asr/data-schema-reader>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <bit>
+
+#include "checks.h"
+
+using namespace asr;
+using namespace std;
+
+/**
+ * Returns `true` if both values have the same bits, NaN payloads and the sign of zero included.
+ */
+bool same (float a, float b) { return bit_cast<uint32_t>(a) == bit_cast<uint32_t>(b); }
+bool same (double a, double b) { return bit_cast<uint64_t>(a) == bit_cast<uint64_t>(b); }
+
+/**
+ * Record with every 64-bit and floating point field, in both byte orders.
+ */
+class Sample
+{
+    public:
+
+    int64_t i64 = 0;
+    uint64_t u64 = 0;
+    float f32 = 0;
+    double f64 = 0;
+
+    int64_t i64be = 0;
+    uint64_t u64be = 0;
+    float f32be = 0;
+    double f64be = 0;
+};
+
+const int SAMPLE_SIZE = 2 * (8 + 8 + 4 + 8);
+
+/**
+ * Writes a sample with the schema and checks its bytes against the Buffer helpers of each byte order.
+ */
+bool encode (DataSchema<Sample> &schema, Sample *sample, Buffer *output)
+{
+    int state[16] = {0};
+    auto *field = schema.root;
+    while (field != nullptr)
+        field = field->write(output, sample, state);
+
+    if (output->bytes_available() != SAMPLE_SIZE)
+        return false;
+
+    char data[SAMPLE_SIZE], expected[SAMPLE_SIZE];
+    output->drain(data, SAMPLE_SIZE, false);
+
+    Buffer::write_uint64_to(expected, (uint64_t)sample->i64);
+    Buffer::write_uint64_to(expected + 8, sample->u64);
+    Buffer::write_float32_to(expected + 16, sample->f32);
+    Buffer::write_float64_to(expected + 20, sample->f64);
+    Buffer::write_uint64be_to(expected + 28, (uint64_t)sample->i64be);
+    Buffer::write_uint64be_to(expected + 36, sample->u64be);
+    Buffer::write_float32be_to(expected + 44, sample->f32be);
+    Buffer::write_float64be_to(expected + 48, sample->f64be);
+
+    return memcmp(data, expected, SAMPLE_SIZE) == 0;
+}
+
+/**
+ * Byte order of the Buffer helpers, checked against literal bytes.
+ */
+void test_byte_order()
+{
+    char buff[8];
+    const unsigned char le64[] = { 0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 };
+    const unsigned char be64[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+
+    Buffer::write_uint64_to(buff, 0x0102030405060708ULL);
+    check("uint64 is written little endian", memcmp(buff, le64, 8) == 0);
+    Buffer::write_uint64be_to(buff, 0x0102030405060708ULL);
+    check("uint64be is written big endian", memcmp(buff, be64, 8) == 0);
+
+    check("uint64 is read little endian", Buffer::read_uint64_from((char *)le64) == 0x0102030405060708ULL);
+    check("uint64be is read big endian", Buffer::read_uint64be_from((char *)be64) == 0x0102030405060708ULL);
+
+    // 1.0f is 0x3F800000 and 1.0 is 0x3FF0000000000000.
+    const unsigned char one32be[] = { 0x3F, 0x80, 0, 0 };
+    const unsigned char one64be[] = { 0x3F, 0xF0, 0, 0, 0, 0, 0, 0 };
+
+    Buffer::write_float32be_to(buff, 1.0f);
+    check("float32be is written big endian", memcmp(buff, one32be, 4) == 0);
+    Buffer::write_float32_to(buff, 1.0f);
+    check("float32 is written little endian", buff[3] == 0x3F && (unsigned char)buff[2] == 0x80 && !buff[0] && !buff[1]);
+
+    Buffer::write_float64be_to(buff, 1.0);
+    check("float64be is written big endian", memcmp(buff, one64be, 8) == 0);
+    Buffer::write_float64_to(buff, 1.0);
+    check("float64 is written little endian", buff[7] == 0x3F && (unsigned char)buff[6] == 0xF0);
+
+    check("float32be is read big endian", Buffer::read_float32be_from((char *)one32be) == 1.0f);
+    check("float64be is read big endian", Buffer::read_float64be_from((char *)one64be) == 1.0);
+}
+
+/**
+ * Limits of the 64-bit integers through the buffer stream methods.
+ */
+void test_buffer()
+{
+    Buffer buffer;
+
+    buffer.write_uint64((uint64_t)INT64_MIN);
+    buffer.write_uint64be((uint64_t)INT64_MAX);
+    buffer.write_uint64(UINT64_MAX);
+    buffer.write_uint64be(0);
+
+    check("int64 min round-trips little endian", buffer.read_int64() == INT64_MIN);
+    check("int64 max round-trips big endian", buffer.read_int64be() == INT64_MAX);
+    check("uint64 max round-trips little endian", buffer.read_uint64() == UINT64_MAX);
+    check("uint64 zero round-trips big endian", buffer.read_uint64be() == 0);
+
+    buffer.write_float32(numeric_limits<float>::denorm_min());
+    buffer.write_float32be(-numeric_limits<float>::infinity());
+    buffer.write_float64(-0.0);
+    buffer.write_float64be(numeric_limits<double>::quiet_NaN());
+
+    check("float32 denormal round-trips little endian", same(buffer.read_float32(), numeric_limits<float>::denorm_min()));
+    check("float32 -inf round-trips big endian", same(buffer.read_float32be(), -numeric_limits<float>::infinity()));
+    check("float64 -0 round-trips little endian", same(buffer.read_float64(), -0.0));
+    check("float64 NaN round-trips big endian", isnan(buffer.read_float64be()));
+    check("buffer is empty after reading", buffer.bytes_available() == 0);
+}
+
+/**
+ * Samples through the schema: written by the fields, checked byte by byte and read back in pieces.
+ */
+void test_schema()
+{
+    DataSchema<Sample> schema;
+    schema
+        .int64(&Sample::i64)
+        ->uint64(&Sample::u64)
+        ->float32(&Sample::f32)
+        ->float64(&Sample::f64)
+        ->int64be(&Sample::i64be)
+        ->uint64be(&Sample::u64be)
+        ->float32be(&Sample::f32be)
+        ->float64be(&Sample::f64be)
+    ;
+
+    const float fnan = numeric_limits<float>::quiet_NaN(), finf = numeric_limits<float>::infinity();
+    const double dnan = numeric_limits<double>::quiet_NaN(), dinf = numeric_limits<double>::infinity();
+    const float fden = numeric_limits<float>::denorm_min(), fmax = numeric_limits<float>::max();
+    const double dden = numeric_limits<double>::denorm_min(), dmin = numeric_limits<double>::min();
+
+    // Each sample has the same value in both byte orders.
+    Sample samples[] = {
+        { INT64_MIN, 0, 0.0f, 0.0, INT64_MIN, 0, 0.0f, 0.0 },
+        { INT64_MAX, UINT64_MAX, -0.0f, -0.0, INT64_MAX, UINT64_MAX, -0.0f, -0.0 },
+        { -1, 0x8000000000000000ULL, finf, -dinf, -1, 0x8000000000000000ULL, finf, -dinf },
+        { 0x0102030405060708LL, 0xFEDCBA9876543210ULL, -finf, dinf, 0x0102030405060708LL, 0xFEDCBA9876543210ULL, -finf, dinf },
+        { 1, 1, fnan, dnan, 1, 1, -fnan, -dnan },
+        { 0, 0, fden, dden, 0, 0, -fden, -dden },
+        { 0, 0, fden * 0x7FFFFF, dmin - dden, 0, 0, fmax, -dmin },
+    };
+
+    const int num_samples = sizeof(samples) / sizeof(Sample);
+
+    Buffer buffer;
+    bool bytes_match = true;
+
+    for (int i = 0; i < num_samples; i++) {
+        Buffer output;
+        bytes_match &= encode(schema, &samples[i], &output);
+        encode(schema, &samples[i], &buffer);
+    }
+
+    check("schema writes the bytes of the Buffer helpers", bytes_match);
+    check("schema writes every sample", buffer.bytes_available() == num_samples * SAMPLE_SIZE);
+
+    // The reader is fed a few bytes at a time, so that fields are split across reads.
+    Buffer input;
+    DataSchemaReader<Sample> reader (&schema, &input);
+
+    char data[7];
+    int decoded = 0;
+    bool values_match = true;
+
+    while (buffer.bytes_available())
+    {
+        int n = buffer.drain(data, buffer.bytes_available() < 7 ? buffer.bytes_available() : 7);
+        input.write(data, n);
+
+        ptr<Sample> sample;
+        while ((sample = reader.feed()) != nullptr && decoded < num_samples)
+        {
+            Sample *expected = &samples[decoded++];
+            values_match &= sample->i64 == expected->i64 && sample->u64 == expected->u64
+                && same(sample->f32, expected->f32) && same(sample->f64, expected->f64)
+                && sample->i64be == expected->i64be && sample->u64be == expected->u64be
+                && same(sample->f32be, expected->f32be) && same(sample->f64be, expected->f64be);
+        }
+    }
+
+    check("reader decodes every sample", decoded == num_samples);
+    check("limits, NaN, infinities and denormals round-trip bit for bit", values_match);
+}
+
+/**
+ */
+int main (int argc, const char *argv[])
+{
+    auto n = asr::memblocks;
+
+    test_byte_order();
+    test_buffer();
+    test_schema();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return checks_summary();
+}
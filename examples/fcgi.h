@@ -0,0 +1,287 @@
+// Generated by rssc from utils/fcgi.schema, do not edit.
+#ifndef __RSSC_FCGI_H
+#define __RSSC_FCGI_H
+
+#include <asr/buffer>
+#include <asr/error>
+#include <bit>
+#include <cstring>
+#include <format>
+
+#ifndef __RSSC_RUNTIME
+#define __RSSC_RUNTIME
+
+/**
+ * Unaligned little/big endian loads and stores used by the generated codecs.
+ */
+namespace rssc
+{
+    inline uint16_t le16 (uint16_t v) { return std::endian::native == std::endian::little ? v : __builtin_bswap16(v); }
+    inline uint32_t le32 (uint32_t v) { return std::endian::native == std::endian::little ? v : __builtin_bswap32(v); }
+    inline uint16_t be16 (uint16_t v) { return std::endian::native == std::endian::big ? v : __builtin_bswap16(v); }
+    inline uint32_t be32 (uint32_t v) { return std::endian::native == std::endian::big ? v : __builtin_bswap32(v); }
+
+    inline uint16_t ld16 (const char *p) { uint16_t v; std::memcpy(&v, p, 2); return v; }
+    inline uint32_t ld32 (const char *p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+    inline int ld_u8 (const char *p) { return (unsigned char)p[0]; }
+    inline int ld_i8 (const char *p) { return (signed char)p[0]; }
+    inline int ld_u16 (const char *p) { return le16(ld16(p)); }
+    inline int ld_i16 (const char *p) { return (int16_t)le16(ld16(p)); }
+    inline int ld_u16be (const char *p) { return be16(ld16(p)); }
+    inline int ld_i16be (const char *p) { return (int16_t)be16(ld16(p)); }
+    inline int ld_u32 (const char *p) { return (int)le32(ld32(p)); }
+    inline int ld_i32 (const char *p) { return (int32_t)le32(ld32(p)); }
+    inline int ld_u32be (const char *p) { return (int)be32(ld32(p)); }
+    inline int ld_i32be (const char *p) { return (int32_t)be32(ld32(p)); }
+
+    inline void st_8 (char *p, int v) { p[0] = (char)v; }
+    inline void st_16 (char *p, int v) { uint16_t x = le16((uint16_t)v); std::memcpy(p, &x, 2); }
+    inline void st_16be (char *p, int v) { uint16_t x = be16((uint16_t)v); std::memcpy(p, &x, 2); }
+    inline void st_32 (char *p, int v) { uint32_t x = le32((uint32_t)v); std::memcpy(p, &x, 4); }
+    inline void st_32be (char *p, int v) { uint32_t x = be32((uint32_t)v); std::memcpy(p, &x, 4); }
+};
+
+#endif
+
+/**
+ * Decodes a `varint` value and advances the pointer. Returns `false` if more data is required.
+ */
+inline bool varint_load (const char *&_p, const char *_end, int &_value)
+{
+    int val = 0;
+
+    if (_end - _p < 1) return false;
+    val = rssc::ld_u8(_p);
+    if (!(val & 0x80)) {
+        if (_end - _p < 1) return false;
+        val = rssc::ld_u8(_p);
+        _p += 1;
+        _value = val;
+        return true;
+    }
+    if (_end - _p < 4) return false;
+    val = rssc::ld_u32be(_p);
+    _p += 4;
+    _value = val & 0x7FFFFFFF;
+    return true;
+}
+
+/**
+ * Encodes a `varint` value and advances the pointer. Returns `false` if there is not enough space.
+ */
+inline bool varint_store (char *&_p, char *_end, int value)
+{
+    if (value < 0x80) {
+        if (_end - _p < 1) return false;
+        rssc::st_8(_p, value);
+        _p += 1;
+        return true;
+    }
+    if (_end - _p < 4) return false;
+    rssc::st_32be(_p, value | 0x80000000);
+    _p += 4;
+    return true;
+}
+
+/**
+ * Record `FCGI_Header` (fixed size of 7 bytes).
+ */
+struct FCGI_Header
+{
+    unsigned int signature = 0;
+    int version = 0;
+    unsigned int checksum = 0;
+
+    static constexpr int SIZE = 7;
+    static constexpr int MAX_SIZE = 7;
+
+    /**
+     * Decodes the record from a contiguous block of memory. Returns the number of bytes consumed or zero if more data
+     * is required. Throws `asr::Error` if a field has an invalid value.
+     */
+    int decode (const char *_data, int _length)
+    {
+        if (_length < 7) return 0;
+        signature = rssc::ld_u32be(_data);
+        switch (signature) {
+            case 0x00DEAD00:
+                break;
+            default:
+                throw asr::Error(std::format("{}: {}", "invalid field value found", signature), 0);
+        }
+        version = rssc::ld_i8(_data + 4);
+        switch (version) {
+            case 1:
+            case 2:
+                break;
+            default:
+                throw asr::Error(std::format("{}: {}", "invalid version", version), 1);
+        }
+        checksum = rssc::ld_u16be(_data + 5);
+        return 7;
+    }
+
+    /**
+     * Reads the record from a buffer. Returns `false` if more data is required, in which case the buffer is left untouched.
+     */
+    bool read (asr::Buffer *input)
+    {
+        char tmp[MAX_SIZE];
+        int n = input->bytes_available() < MAX_SIZE ? input->bytes_available() : MAX_SIZE;
+        if (input->drain(tmp, n, false) != n) return false;
+
+        n = decode(tmp, n);
+        if (!n) return false;
+
+        input->drain(n);
+        return true;
+    }
+
+    /**
+     * Decodes up to `_count` consecutive records into `_output` and advances `_data` past them. Returns the number of
+     * records decoded, stops at the first incomplete record. Throws `asr::Error` if a field has an invalid value, in
+     * which case `_data` points to the offending record.
+     */
+    static int decode_batch (const char *&_data, const char *_end, FCGI_Header *_output, int _count)
+    {
+        int n = (_end - _data) / SIZE;
+        if (n > _count) n = _count;
+
+        for (int i = 0; i < n; i++, _data += SIZE)
+        {
+            FCGI_Header& r = _output[i];
+            r.signature = rssc::ld_u32be(_data);
+            r.version = rssc::ld_i8(_data + 4);
+            r.checksum = rssc::ld_u16be(_data + 5);
+            if (!((r.signature == 0x00DEAD00) & ((r.version == 1) | (r.version == 2))))
+                r.decode(_data, SIZE); // Throws the error.
+        }
+
+        return n < 0 ? 0 : n;
+    }
+
+    /**
+     * Encodes the record into a contiguous block of memory. Returns the number of bytes written or zero if there is
+     * not enough space. Throws `asr::Error` if a field has an invalid value.
+     */
+    int encode (char *_data, int _length) const
+    {
+        if (_length < 7) return 0;
+        rssc::st_32be(_data, signature);
+        switch (signature) {
+            case 0x00DEAD00:
+                break;
+            default:
+                throw asr::Error(std::format("{}: {}", "invalid field value found", signature), 0);
+        }
+        rssc::st_8(_data + 4, version);
+        switch (version) {
+            case 1:
+            case 2:
+                break;
+            default:
+                throw asr::Error(std::format("{}: {}", "invalid version", version), 1);
+        }
+        rssc::st_16be(_data + 5, checksum);
+        return 7;
+    }
+
+    /**
+     * Writes the record to a buffer (all or nothing). Returns `false` if there is not enough space.
+     */
+    bool write (asr::Buffer *output) const
+    {
+        char tmp[MAX_SIZE];
+        int n = encode(tmp, MAX_SIZE);
+        return n && output->write(tmp, n);
+    }
+};
+
+/**
+ * Record `FCGI_NameValue` (variable size).
+ */
+struct FCGI_NameValue
+{
+    int name_length = 0;
+    int value_length = 0;
+
+    static constexpr int MAX_SIZE = 12;
+
+    /**
+     * Decodes the record from a contiguous block of memory. Returns the number of bytes consumed or zero if more data
+     * is required. Throws `asr::Error` if a field has an invalid value.
+     */
+    int decode (const char *_data, int _length)
+    {
+        const char *_p = _data, *_end = _data + _length;
+        {
+            int _value;
+            if (!varint_load(_p, _end, _value)) return 0;
+            name_length = _value;
+        }
+        {
+            int _value;
+            if (!varint_load(_p, _end, _value)) return 0;
+            value_length = _value;
+        }
+        return _p - _data;
+    }
+
+    /**
+     * Reads the record from a buffer. Returns `false` if more data is required, in which case the buffer is left untouched.
+     */
+    bool read (asr::Buffer *input)
+    {
+        char tmp[MAX_SIZE];
+        int n = input->bytes_available() < MAX_SIZE ? input->bytes_available() : MAX_SIZE;
+        if (input->drain(tmp, n, false) != n) return false;
+
+        n = decode(tmp, n);
+        if (!n) return false;
+
+        input->drain(n);
+        return true;
+    }
+
+    /**
+     * Decodes up to `_count` consecutive records into `_output` and advances `_data` past them. Returns the number of
+     * records decoded, stops at the first incomplete record. Throws `asr::Error` if a field has an invalid value, in
+     * which case `_data` points to the offending record.
+     */
+    static int decode_batch (const char *&_data, const char *_end, FCGI_NameValue *_output, int _count)
+    {
+        int i = 0;
+        for (; i < _count; i++) {
+            int n = _output[i].decode(_data, _end - _data);
+            if (!n) break;
+            _data += n;
+        }
+
+        return i;
+    }
+
+    /**
+     * Encodes the record into a contiguous block of memory. Returns the number of bytes written or zero if there is
+     * not enough space. Throws `asr::Error` if a field has an invalid value.
+     */
+    int encode (char *_data, int _length) const
+    {
+        char *_p = _data, *_end = _data + _length;
+        if (!varint_store(_p, _end, name_length)) return 0;
+        if (!varint_store(_p, _end, value_length)) return 0;
+        return _p - _data;
+    }
+
+    /**
+     * Writes the record to a buffer (all or nothing). Returns `false` if there is not enough space.
+     */
+    bool write (asr::Buffer *output) const
+    {
+        char tmp[MAX_SIZE];
+        int n = encode(tmp, MAX_SIZE);
+        return n && output->write(tmp, n);
+    }
+};
+
+#endif
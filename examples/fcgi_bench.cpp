@@ -0,0 +1,213 @@
+// Generated by rssc from utils/fcgi.schema, do not edit.
+#include "fcgi.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Deterministic pseudo-random generator (xorshift32) used to build the corpus.
+ */
+static uint32_t seed = 0x9E3779B9;
+
+static uint32_t rnd() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/**
+ * Keeps the results alive.
+ */
+static volatile int sink = 0;
+
+/**
+ * Prints the throughput of a measurement.
+ */
+static void report (const char *record, const char *name, chrono::steady_clock::duration elapsed, double num_frames, double num_bytes)
+{
+    double ns = chrono::duration<double, nano>(elapsed).count();
+    printf("%-24s %-14s %8.2f ns/frame %10.2f Mframes/s %10.2f MB/s\n", record, name,
+        ns / num_frames, num_frames * 1e3 / ns, num_bytes * 1e3 / ns);
+}
+
+/**
+ * Fills a `FCGI_Header` with random values that pass all checks.
+ */
+static void random_FCGI_Header (FCGI_Header& r)
+{
+    r.signature = 0x00DEAD00;
+    switch (rnd() % 2) {
+        case 0: r.version = 1; break;
+        case 1: r.version = 2; break;
+    }
+    r.checksum = rnd() & 0xFFFF;
+}
+
+/**
+ * Benchmarks the `FCGI_Header` codec. Returns `false` if the round-trip check fails.
+ */
+static bool bench_FCGI_Header (int num_frames, int rounds)
+{
+    vector<char> corpus ((size_t)num_frames * FCGI_Header::MAX_SIZE);
+    vector<char> copy (corpus.size());
+    vector<FCGI_Header> records (num_frames);
+
+    char *p = corpus.data();
+    for (auto& r : records) {
+        random_FCGI_Header(r);
+        p += r.encode(p, FCGI_Header::MAX_SIZE);
+    }
+
+    long length = p - corpus.data();
+    const char *begin = corpus.data(), *end = begin + length;
+
+    try
+    {
+        // Round-trip check.
+        const char *q = begin;
+        p = copy.data();
+        for (auto& r : records) {
+            q += r.decode(q, end - q);
+            p += r.encode(p, FCGI_Header::MAX_SIZE);
+        }
+
+        if (q != end || memcmp(begin, copy.data(), length) != 0) {
+            printf("%-24s \e[91mround-trip mismatch\e[0m\n", "FCGI_Header");
+            return false;
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        for (int k = 0; k < rounds; k++) {
+            q = begin;
+            for (auto& r : records)
+                q += r.decode(q, end - q);
+        }
+        auto t1 = chrono::steady_clock::now();
+        report("FCGI_Header", "decode", t1 - t0, (double)num_frames * rounds, (double)length * rounds);
+
+        t0 = chrono::steady_clock::now();
+        for (int k = 0; k < rounds; k++) {
+            q = begin;
+            FCGI_Header::decode_batch(q, end, records.data(), num_frames);
+        }
+        t1 = chrono::steady_clock::now();
+        report("FCGI_Header", "decode_batch", t1 - t0, (double)num_frames * rounds, (double)length * rounds);
+
+        t0 = chrono::steady_clock::now();
+        for (int k = 0; k < rounds; k++) {
+            p = copy.data();
+            for (auto& r : records)
+                p += r.encode(p, FCGI_Header::MAX_SIZE);
+        }
+        t1 = chrono::steady_clock::now();
+        report("FCGI_Header", "encode", t1 - t0, (double)num_frames * rounds, (double)length * rounds);
+    }
+    catch (asr::Error& e) {
+        printf("%-24s \e[91m%s\e[0m\n", "FCGI_Header", e.message());
+        return false;
+    }
+
+    sink = sink + (int)copy[length - 1];
+    return true;
+}
+
+/**
+ * Fills a `FCGI_NameValue` with random values that pass all checks.
+ */
+static void random_FCGI_NameValue (FCGI_NameValue& r)
+{
+    r.name_length = (rnd() & 0x7FFFFFFF) >> (rnd() & 31);
+    r.value_length = (rnd() & 0x7FFFFFFF) >> (rnd() & 31);
+}
+
+/**
+ * Benchmarks the `FCGI_NameValue` codec. Returns `false` if the round-trip check fails.
+ */
+static bool bench_FCGI_NameValue (int num_frames, int rounds)
+{
+    vector<char> corpus ((size_t)num_frames * FCGI_NameValue::MAX_SIZE);
+    vector<char> copy (corpus.size());
+    vector<FCGI_NameValue> records (num_frames);
+
+    char *p = corpus.data();
+    for (auto& r : records) {
+        random_FCGI_NameValue(r);
+        p += r.encode(p, FCGI_NameValue::MAX_SIZE);
+    }
+
+    long length = p - corpus.data();
+    const char *begin = corpus.data(), *end = begin + length;
+
+    try
+    {
+        // Round-trip check.
+        const char *q = begin;
+        p = copy.data();
+        for (auto& r : records) {
+            q += r.decode(q, end - q);
+            p += r.encode(p, FCGI_NameValue::MAX_SIZE);
+        }
+
+        if (q != end || memcmp(begin, copy.data(), length) != 0) {
+            printf("%-24s \e[91mround-trip mismatch\e[0m\n", "FCGI_NameValue");
+            return false;
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        for (int k = 0; k < rounds; k++) {
+            q = begin;
+            for (auto& r : records)
+                q += r.decode(q, end - q);
+        }
+        auto t1 = chrono::steady_clock::now();
+        report("FCGI_NameValue", "decode", t1 - t0, (double)num_frames * rounds, (double)length * rounds);
+
+        t0 = chrono::steady_clock::now();
+        for (int k = 0; k < rounds; k++) {
+            q = begin;
+            FCGI_NameValue::decode_batch(q, end, records.data(), num_frames);
+        }
+        t1 = chrono::steady_clock::now();
+        report("FCGI_NameValue", "decode_batch", t1 - t0, (double)num_frames * rounds, (double)length * rounds);
+
+        t0 = chrono::steady_clock::now();
+        for (int k = 0; k < rounds; k++) {
+            p = copy.data();
+            for (auto& r : records)
+                p += r.encode(p, FCGI_NameValue::MAX_SIZE);
+        }
+        t1 = chrono::steady_clock::now();
+        report("FCGI_NameValue", "encode", t1 - t0, (double)num_frames * rounds, (double)length * rounds);
+    }
+    catch (asr::Error& e) {
+        printf("%-24s \e[91m%s\e[0m\n", "FCGI_NameValue", e.message());
+        return false;
+    }
+
+    sink = sink + (int)copy[length - 1];
+    return true;
+}
+
+/**
+ * Usage: <program> [num_frames] [rounds]
+ */
+int main (int argc, const char *argv[])
+{
+    int num_frames = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    bool ok = true;
+
+    if (num_frames < 1 || rounds < 1) {
+        printf("Usage: %s [num_frames] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    ok = bench_FCGI_Header(num_frames, rounds) && ok;
+    ok = bench_FCGI_NameValue(num_frames, rounds) && ok;
+
+    return ok ? 0 : 1;
+}
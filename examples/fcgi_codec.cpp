@@ -0,0 +1,93 @@
+#include <asr/data-schema-reader>
+#include <iostream>
+#include <chrono>
+
+#include "fcgi.h"
+
+using namespace asr;
+using namespace std;
+
+/**
+ * Same layout as the `FCGI_Header` record of utils/fcgi.schema, described for the runtime interpreter.
+ */
+class Header
+{
+    public:
+
+    unsigned int signature = 0;
+    int version = 0;
+    unsigned int checksum = 0;
+};
+
+constexpr int NUM_FRAMES = 200000;
+
+/**
+ */
+void test()
+{
+    DataSchema<Header> schema;
+    schema
+        .uint32be(&Header::signature)
+            ->throws(0, "invalid signature")
+            ->when(0x00DEAD00)->end()
+        ->int8(&Header::version)
+            ->throws(1, "invalid version")
+            ->when(1)->end()
+            ->when(2)->end()
+        ->uint16be(&Header::checksum)
+    ;
+
+    Buffer buffer (NUM_FRAMES * FCGI_Header::SIZE);
+
+    FCGI_Header hdr;
+    hdr.signature = 0x00DEAD00;
+    for (int i = 0; i < NUM_FRAMES; i++) {
+        hdr.version = 1 + (i & 1);
+        hdr.checksum = i & 0xFFFF;
+        hdr.write(&buffer);
+    }
+
+    // Generated codec.
+    auto t0 = chrono::steady_clock::now();
+    unsigned int sum1 = 0;
+    const char *data = buffer.get_data();
+    for (int i = 0; i < NUM_FRAMES; i++) {
+        data += hdr.decode(data, FCGI_Header::SIZE);
+        sum1 += hdr.checksum;
+    }
+    auto t1 = chrono::steady_clock::now();
+
+    // Runtime interpreter.
+    unsigned int sum2 = 0;
+    DataSchemaReader<Header> reader(&schema, &buffer);
+    for (int i = 0; i < NUM_FRAMES; i++) {
+        auto msg = reader.feed();
+        if (!msg) break;
+        sum2 += msg->checksum;
+    }
+    auto t2 = chrono::steady_clock::now();
+
+    auto us1 = chrono::duration_cast<chrono::microseconds>(t1 - t0).count();
+    auto us2 = chrono::duration_cast<chrono::microseconds>(t2 - t1).count();
+
+    cout << "rssc:        " << us1 << " us (" << (NUM_FRAMES * 1000.0 / (us1 ? us1 : 1)) << " frames/ms)" << endl;
+    cout << "data-schema: " << us2 << " us (" << (NUM_FRAMES * 1000.0 / (us2 ? us2 : 1)) << " frames/ms)" << endl;
+
+    if (sum1 != sum2)
+        cout << "\e[91mError: checksum mismatch " << sum1 << " != " << sum2 << "\e[0m" << endl;
+}
+
+/**
+ */
+int main (int argc, const char *argv[])
+{
+    auto n = asr::memblocks;
+
+    test();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <asr/socket-addr-ip4>
+#include <asr/io-engine>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <unistd.h>
+
+using namespace asr;
+using namespace std;
+
+constexpr int PORT = 2200;
+
+int num_clients = 32;
+int num_rounds = 2000;
+int batch_size = 64;
+int message_size = 64;
+
+/**
+ * Echo server state shared by the handlers.
+ */
+struct Server
+{
+    IOEngine *engine;
+    unordered_map<SOCKET, ptr<SocketTCP>> clients;
+};
+
+/**
+ */
+void on_data (Socket *socket, Buffer *input, void *data)
+{
+    Server *server = (Server *)data;
+    if (!input) {
+        server->clients.erase(socket->socket);
+        return;
+    }
+
+    int length;
+    const char *bytes = input->peek(length);
+    server->engine->send((SocketTCP *)socket, bytes, length);
+}
+
+/**
+ */
+void on_accept (SocketTCP *listener, ptr<SocketTCP> client, void *data)
+{
+    Server *server = (Server *)data;
+    server->clients[client->socket] = client;
+    server->engine->recv(client.get(), on_data, server);
+}
+
+/**
+ * Sends batches of messages and waits for them to be echoed back, returns `false` on mismatch. Uses plain sockets since
+ * it runs in its own thread and `ptr` reference counting is not thread-safe.
+ */
+bool client (atomic<int> *done)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    bool ok = ::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+
+    int length = batch_size * message_size;
+    vector<char> output(length), input(length);
+    for (int i = 0; i < length; i++)
+        output[i] = i * 7;
+
+    for (int r = 0; ok && r < num_rounds; r++)
+    {
+        if (::send(fd, output.data(), length, MSG_NOSIGNAL) != length)
+            ok = false;
+
+        for (int n = 0; ok && n < length; ) {
+            int k = ::recv(fd, input.data() + n, length - n, 0);
+            if (k <= 0) ok = false;
+            n += k;
+        }
+
+        ok = ok && !memcmp(input.data(), output.data(), length);
+    }
+
+    ::close(fd);
+    (*done)++;
+    return ok;
+}
+
+/**
+ */
+void bench (IOEngineType type)
+{
+    ptr<IOEngine> engine = IOEngine::create(type);
+    if (!engine) {
+        cout << "\e[90mEngine not supported on this system\e[0m" << endl;
+        return;
+    }
+
+    SocketTCP listener;
+    if (!listener.bind(new SockAddrIP4("127.0.0.1", PORT)) || !listener.listen(1024)) {
+        cout << "Error: Unable to listen on port " << PORT << endl;
+        return;
+    }
+
+    Server server;
+    server.engine = engine.get();
+    engine->accept(&listener, on_accept, &server);
+
+    atomic<int> done(0);
+    atomic<int> failed(0);
+    vector<thread> threads;
+
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < num_clients; i++)
+        threads.emplace_back([&]() { if (!client(&done)) failed++; });
+
+    while (done < num_clients)
+        engine->poll(10);
+
+    auto t1 = chrono::steady_clock::now();
+    for (auto& t : threads) t.join();
+
+    for (auto& i : server.clients)
+        engine->remove(i.second.get());
+    engine->remove(&listener);
+    server.clients.clear();
+
+    double secs = chrono::duration<double>(t1 - t0).count();
+    double messages = (double)num_clients * num_rounds * batch_size;
+
+    cout << engine->name() << ": " << (int)(messages / secs / 1000) << "k msg/s, "
+         << (int)(messages * message_size * 2 / secs / 1048576) << " MB/s, "
+         << (engine->num_polls ? engine->num_events / engine->num_polls : 0) << " events/poll";
+
+    if (failed)
+        cout << " \e[91m(" << failed << " clients failed)\e[0m";
+    cout << endl;
+}
+
+/**
+ * Usage: io_engine_bench [clients] [rounds] [batch] [message_size]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_clients = atoi(argv[1]);
+    if (argc > 2) num_rounds = atoi(argv[2]);
+    if (argc > 3) batch_size = atoi(argv[3]);
+    if (argc > 4) message_size = atoi(argv[4]);
+
+    auto n = asr::memblocks;
+
+    bench(IO_ENGINE_REACTOR);
+    bench(IO_ENGINE_URING);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
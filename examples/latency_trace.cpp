@@ -0,0 +1,203 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-tcp>
+#include <asr/socket-udp>
+#include <asr/data-schema-reader>
+#include <asr/latency-histogram>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <netinet/tcp.h>
+
+using namespace asr;
+using namespace std;
+
+int num_records = 20000;
+int interval = 20;
+
+/**
+ * Record sent by the client, same layout as the header of examples/fcgi_codec.
+ */
+class Header
+{
+    public:
+
+    unsigned int signature = 0;
+    int version = 0;
+    unsigned int checksum = 0;
+};
+
+LatencyTrace stages ({ "wire>read", "decode", "handler" });
+unsigned int checksum = 0;
+
+/**
+ * Handler of the decoded records, the trace is marked on entry.
+ */
+__attribute__((noinline)) void on_header (Header *header)
+{
+    stages.mark(2);
+    checksum += header->checksum;
+}
+
+/**
+ * Sends the records one at a time every `interval` microseconds, so that each read returns (about) one record.
+ */
+void produce (int port)
+{
+    SocketTCP client;
+    if (!client.connect(new SockAddrIP4("127.0.0.1", port)))
+        return;
+
+    int one = 1;
+    setsockopt(client.socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    char record[7];
+    for (int i = 0; i < num_records; i++)
+    {
+        Buffer::write_uint32be_to(record, 0x00DEAD00);
+        record[4] = 1 + (i & 1);
+        record[5] = (i >> 8) & 0xFF;
+        record[6] = i & 0xFF;
+
+        client.send(record, sizeof(record));
+        this_thread::sleep_for(chrono::microseconds(interval));
+    }
+
+    client.close();
+}
+
+/**
+ * Reads the records from a timestamped connection, tracing each from the kernel receive timestamp to the handler.
+ */
+void test_tcp()
+{
+    SocketTCP listener;
+    listener.bind(new SockAddrIP4("127.0.0.1", 0));
+    listener.listen();
+
+    // Inherited by the accepted connection.
+    if (!listener.set_timestamping(true)) {
+        cout << "\e[90mKernel timestamps not supported on this system\e[0m" << endl;
+        return;
+    }
+
+    thread producer (produce, ((SockAddrIP4 *)listener.local.get())->get_port());
+
+    ptr<SocketTCP> server;
+    while ((server = listener.accept()) == nullptr)
+        listener.is_readable(100);
+
+    DataSchema<Header> schema;
+    schema
+        .uint32be(&Header::signature)
+            ->throws(0, "invalid signature")
+            ->when(0x00DEAD00)->end()
+        ->int8(&Header::version)
+            ->throws(1, "invalid version")
+            ->when(1)->end()
+            ->when(2)->end()
+        ->uint16be(&Header::checksum)
+    ;
+
+    Buffer input;
+    DataSchemaReader<Header> reader (&schema, &input);
+
+    char data[4096];
+    int records = 0, untimed = 0;
+
+    while (true)
+    {
+        int n = server->recv(data, sizeof(data));
+        if (n <= 0) break;
+
+        int64_t received = server->get_rx_timestamp();
+        int64_t read = LatencyTrace::now();
+        if (!received) untimed++;
+
+        input.write(data, n);
+
+        // Records of the same read share its timestamps, each is decoded and handled in turn.
+        while (true)
+        {
+            auto msg = reader.feed();
+            if (msg == nullptr) break;
+
+            stages.start(received ? received : read);
+            stages.mark(0, read);
+            stages.mark(1);
+            on_header(msg.get());
+            records++;
+            read = LatencyTrace::now();
+        }
+    }
+
+    producer.join();
+
+    cout << "tcp     : " << records << " records" << (untimed ? ", \e[91mreads without timestamp\e[0m" : "") << endl;
+    stages.dump(cout);
+}
+
+/**
+ * Receives datagrams in batches, each datagram traced from its own receive timestamp.
+ */
+void test_udp()
+{
+    SocketUDP receiver (new SockAddrIP4("127.0.0.1", 0));
+    receiver.set_nonblocking(true);
+    if (!receiver.set_timestamping(true))
+        return;
+
+    ptr<SockAddr> target = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)receiver.local.get())->get_port());
+
+    thread producer ([&]() {
+        SocketUDP sender (new SockAddrIP4("127.0.0.1", 0));
+        char message[64] = {0};
+        for (int i = 0; i < num_records; i++) {
+            sender.send(target, message, sizeof(message));
+            if (i % 8 == 7) this_thread::sleep_for(chrono::microseconds(interval * 8));
+        }
+    });
+
+    LatencyTrace udp ({ "wire>read", "handler" });
+    DatagramBatch batch;
+    int datagrams = 0;
+
+    while (datagrams < num_records && receiver.is_readable(200))
+    {
+        int n = receiver.recv(batch);
+        if (n <= 0) continue;
+
+        int64_t read = LatencyTrace::now();
+        for (int i = 0; i < n; i++) {
+            udp.start(batch.timestamp(i));
+            udp.mark(0, read);
+            udp.mark(1);
+        }
+
+        datagrams += n;
+    }
+
+    producer.join();
+
+    cout << "udp     : " << datagrams << " datagrams" << (batch.timestamp(0) ? "" : ", \e[91mno timestamps\e[0m") << endl;
+    udp.dump(cout);
+}
+
+/**
+ * Usage: latency_trace [records] [interval-us]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_records = atoi(argv[1]);
+    if (argc > 2) interval = atoi(argv[2]);
+
+    auto n = asr::memblocks;
+
+    test_tcp();
+    test_udp();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-udp>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+
+using namespace asr;
+using namespace std;
+
+const int num_groups = 16;
+int per_group = 200;
+
+/**
+ * Returns the address of a group of the feed.
+ */
+ptr<SockAddr> group_addr (int index, int port=0)
+{
+    char ip[32];
+    sprintf(ip, "239.255.77.%d", index + 1);
+    return new SockAddrIP4(ip, port);
+}
+
+/**
+ * Receives in batches what is waiting (or arrives within `timeout`), counting the datagrams of each group by their
+ * destination address. Returns the number of datagrams whose destination did not match the group in the payload.
+ */
+int consume (SocketUDP &receiver, DatagramBatch &batch, int *counts, int &calls, ptr<SockAddr> *sender, int timeout=0)
+{
+    int mismatched = 0;
+    while (receiver.is_readable(timeout))
+    {
+        int n = receiver.recv(batch);
+        if (n <= 0) break;
+        calls++;
+
+        for (int i = 0; i < n; i++)
+        {
+            int g = atoi(batch.data(i));
+            counts[g]++;
+
+            SockAddrIP4 *dest = (SockAddrIP4 *)batch.destination(i);
+            if (dest == nullptr || dest->get_address_int() != ((SockAddrIP4 *)group_addr(g).get())->get_address_int())
+                mismatched++;
+
+            if (sender && *sender == nullptr) {
+                *sender = new SockAddrIP4();
+                (*sender)->set(batch.remote(i));
+            }
+        }
+    }
+
+    return mismatched;
+}
+
+/**
+ * Sends `per_group` datagrams to each group, one round over all groups at a time as a feed would, consuming them as
+ * they arrive.
+ */
+int publish (SocketUDP &sender, int port, SocketUDP &receiver, DatagramBatch &batch, int *counts, int &calls, ptr<SockAddr> *source)
+{
+    ptr<SockAddr> groups[num_groups];
+    for (int g = 0; g < num_groups; g++)
+        groups[g] = group_addr(g, port);
+
+    char message[64];
+    int mismatched = 0;
+
+    for (int i = 0; i < per_group; i++) {
+        for (int g = 0; g < num_groups; g++) {
+            int n = sprintf(message, "%d:%d", g, i);
+            while (sender.send(groups[g], message, n) == IO_WOULD_BLOCK)
+                sender.is_writeable(100);
+        }
+
+        mismatched += consume(receiver, batch, counts, calls, source);
+    }
+
+    return mismatched + consume(receiver, batch, counts, calls, source, 200);
+}
+
+/**
+ */
+void test()
+{
+    SocketUDP receiver (new SockAddrIP4(0));
+    int port = ((SockAddrIP4 *)receiver.local.get())->get_port();
+    receiver.set_nonblocking(true);
+    receiver.set_pktinfo(true);
+
+    for (int g = 0; g < num_groups; g++) {
+        if (!receiver.join_group(group_addr(g))) {
+            cout << "\e[90mUnable to join multicast groups (no multicast route?)\e[0m" << endl;
+            return;
+        }
+    }
+
+    // Kept on this host: no hops, looped back to the local members.
+    SocketUDP sender (new SockAddrIP4(0));
+    sender.set_multicast_ttl(0);
+    sender.set_multicast_loop(true);
+
+    DatagramBatch batch;
+    int counts[num_groups] = {0}, calls = 0, total = 0;
+    ptr<SockAddr> source;
+
+    int mismatched = publish(sender, port, receiver, batch, counts, calls, &source);
+
+    for (int g = 0; g < num_groups; g++)
+        total += counts[g];
+
+    cout << "joined  : " << total << " of " << num_groups * per_group << " datagrams from " << num_groups << " groups, "
+         << (calls ? total / calls : 0) << " per receive call" << (mismatched ? " \e[91m(destination mismatch)\e[0m" : "") << endl;
+
+    if (source == nullptr)
+        return;
+
+    // Half of the groups are left, their datagrams are filtered before reaching the socket.
+    for (int g = 0; g < num_groups; g += 2)
+        receiver.leave_group(group_addr(g));
+
+    memset(counts, 0, sizeof(counts));
+    publish(sender, port, receiver, batch, counts, calls, nullptr);
+
+    int left = 0, kept = 0;
+    for (int g = 0; g < num_groups; g++)
+        (g % 2 ? kept : left) += counts[g];
+
+    cout << "left    : " << left << " datagrams from the groups left, " << kept << " from the others" << endl;
+
+    // Source-specific joins: only datagrams from the given sender pass.
+    SocketUDP ssm_right (new SockAddrIP4(0));
+    SocketUDP ssm_wrong (new SockAddrIP4(0));
+    ssm_right.set_nonblocking(true);
+    ssm_wrong.set_nonblocking(true);
+
+    SockAddrIP4 *src = (SockAddrIP4 *)source.get();
+    char ip[INET_ADDRSTRLEN];
+    ptr<SockAddr> right = new SockAddrIP4(src->get_address(ip, sizeof(ip)), 0);
+    ptr<SockAddr> wrong = new SockAddrIP4("192.0.2.254", 0);
+    ptr<SockAddr> ssm_group = new SockAddrIP4("232.1.1.1", 0);
+
+    bool joined = ssm_right.join_group(ssm_group, right) && ssm_wrong.join_group(ssm_group, wrong);
+
+    char buffer[64];
+    int got_right = 0, got_wrong = 0;
+    for (int i = 0; joined && i < 10; i++) {
+        sender.send(new SockAddrIP4("232.1.1.1", ((SockAddrIP4 *)ssm_right.local.get())->get_port()), "ssm", 3);
+        sender.send(new SockAddrIP4("232.1.1.1", ((SockAddrIP4 *)ssm_wrong.local.get())->get_port()), "ssm", 3);
+    }
+
+    while (joined && ssm_right.is_readable(100) && ssm_right.recv(buffer, sizeof(buffer)) > 0) got_right++;
+    while (joined && ssm_wrong.is_readable(100) && ssm_wrong.recv(buffer, sizeof(buffer)) > 0) got_wrong++;
+
+    cout << "ssm     : " << got_right << " of 10 from source " << ip << ", " << got_wrong << " with another source" << endl;
+}
+
+/**
+ * Usage: multicast [datagrams-per-group]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) per_group = atoi(argv[1]);
+
+    auto n = asr::memblocks;
+
+    test();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
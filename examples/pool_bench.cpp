@@ -0,0 +1,243 @@
+#include <asr/socket-addr-ip4>
+#include <asr/connection-pool>
+#include <asr/reactor>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+using namespace asr;
+using namespace std;
+
+int num_requests = 5000;
+int num_threads = 8;
+int message_size = 64;
+
+/**
+ * Echo server running on its own thread, `drop` closes all its connections (as a backend restarting would).
+ */
+struct Server
+{
+    Reactor reactor;
+    SocketTCP listener;
+    unordered_map<SOCKET, ptr<SocketTCP>> clients;
+    vector<ptr<SocketTCP>> accepted;
+    atomic<bool> done;
+    atomic<bool> drop;
+};
+
+/**
+ */
+void on_data (Socket *socket, int events, void *data)
+{
+    Server *server = (Server *)data;
+    SocketTCP *client = (SocketTCP *)socket;
+    char buffer[4096];
+    int n;
+
+    while ((n = client->recv(buffer, sizeof(buffer))) > 0)
+        client->write(buffer, n);
+
+    if (n == IO_ERROR || (events & (EV_HANGUP | EV_ERROR))) {
+        server->reactor.remove(socket);
+        server->clients.erase(socket->socket);
+    }
+}
+
+/**
+ */
+void on_accept (Socket *socket, int events, void *data)
+{
+    Server *server = (Server *)data;
+
+    while (server->listener.accept(server->accepted) > 0)
+    {
+        for (auto& client : server->accepted) {
+            server->reactor.add(client.get(), EV_READ, on_data, server);
+            server->clients[client->socket] = client;
+        }
+
+        server->accepted.clear();
+    }
+}
+
+/**
+ */
+void serve (Server *server)
+{
+    while (!server->done)
+    {
+        server->reactor.poll(20);
+
+        if (server->drop) {
+            for (auto& i : server->clients)
+                server->reactor.remove(i.second.get());
+            server->clients.clear();
+            server->drop = false;
+        }
+    }
+
+    for (auto& i : server->clients)
+        server->reactor.remove(i.second.get());
+    server->clients.clear();
+    server->reactor.remove(&server->listener);
+}
+
+/**
+ * Sends a message and waits for the echo, returns `false` if the exchange failed.
+ */
+bool request (SocketTCP *socket)
+{
+    char buffer[4096];
+    memset(buffer, 'x', message_size);
+
+    if (socket->send(buffer, message_size) != message_size)
+        return false;
+
+    int received = 0;
+    while (received < message_size)
+    {
+        int n = socket->recv(buffer, sizeof(buffer));
+        if (n > 0)
+            received += n;
+        else if (n == IO_ERROR || !socket->is_readable(1000))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ */
+void print (const char *name, double secs, int count, PoolStats stats)
+{
+    cout << name << ": " << (int)(count / secs) << " req/s, " << stats.created << " connects, " << stats.reused
+         << " reused, " << stats.stale << " stale, wait avg " << (int)stats.average_wait() << " us max "
+         << stats.max_wait << " us" << endl;
+}
+
+/**
+ * Issues requests from several threads through a pool with fewer connections than threads.
+ */
+void contended (ConnectionPool *pool, ptr<SockAddr> addr, atomic<int> *failed)
+{
+    for (int i = 0; i < num_requests / num_threads; i++)
+    {
+        ptr<SocketTCP> socket = pool->acquire(addr, 5000);
+        if (socket == nullptr) {
+            (*failed)++;
+            continue;
+        }
+
+        bool ok = request(socket.get());
+        if (!ok) (*failed)++;
+        pool->release(socket, ok);
+    }
+}
+
+/**
+ */
+void test()
+{
+    Server server;
+    server.done = false;
+    server.drop = false;
+
+    server.listener.bind(new SockAddrIP4("127.0.0.1", 0));
+    server.listener.listen(1024);
+    server.reactor.add(&server.listener, EV_READ, on_accept, &server);
+
+    ptr<SockAddr> addr = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)server.listener.local.get())->get_port());
+    thread t (serve, &server);
+
+    // One connection per request.
+    {
+        int failed = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < num_requests; i++) {
+            ptr<SocketTCP> socket = new SocketTCP();
+            if (!socket->connect(addr) || !request(socket.get()))
+                failed++;
+        }
+
+        PoolStats stats;
+        stats.created = num_requests;
+        print("connect ", chrono::duration<double>(chrono::steady_clock::now() - t0).count(), num_requests, stats);
+        if (failed) cout << "\e[91m" << failed << " requests failed\e[0m" << endl;
+    }
+
+    // Pooled connections, then a backend restart: the stale ones are caught by the probe and replaced.
+    {
+        ConnectionPool pool (2, 8);
+        pool.add_remote(addr);
+        pool.maintain();
+
+        int failed = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < num_requests; i++)
+        {
+            ptr<SocketTCP> socket = pool.acquire(addr);
+            bool ok = socket != nullptr && request(socket.get());
+            if (!ok) failed++;
+            pool.release(socket, ok);
+        }
+
+        print("pooled  ", chrono::duration<double>(chrono::steady_clock::now() - t0).count(), num_requests, pool.stats());
+
+        server.drop = true;
+        while (server.drop) this_thread::sleep_for(chrono::milliseconds(1));
+        this_thread::sleep_for(chrono::milliseconds(20));
+
+        ptr<SocketTCP> socket = pool.acquire(addr);
+        bool ok = socket != nullptr && request(socket.get());
+        pool.release(socket, ok);
+
+        cout << "restart : request " << (ok ? "succeeded" : "\e[91mfailed\e[0m") << ", " << pool.stats().stale
+             << " stale connections discarded" << endl;
+
+        if (failed) cout << "\e[91m" << failed << " requests failed\e[0m" << endl;
+    }
+
+    // More threads than connections, requests wait for a release.
+    {
+        ConnectionPool pool (0, 4, 2);
+        atomic<int> failed (0);
+        vector<thread> threads;
+
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < num_threads; i++)
+            threads.emplace_back(contended, &pool, addr, &failed);
+        for (auto& i : threads)
+            i.join();
+
+        print("shared  ", chrono::duration<double>(chrono::steady_clock::now() - t0).count(),
+            num_requests / num_threads * num_threads, pool.stats());
+
+        if (failed) cout << "\e[91m" << failed << " requests failed\e[0m" << endl;
+    }
+
+    server.done = true;
+    t.join();
+}
+
+/**
+ * Usage: pool_bench [requests] [threads]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_requests = atoi(argv[1]);
+    if (argc > 2) num_threads = atoi(argv[2]);
+
+    auto n = asr::memblocks;
+
+    test();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
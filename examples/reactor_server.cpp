@@ -0,0 +1,105 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-tcp>
+#include <asr/reactor>
+#include <csignal>
+#include <iostream>
+#include <unordered_map>
+#include <sys/resource.h>
+
+using namespace asr;
+using namespace std;
+
+typedef unordered_map<SOCKET, ptr<SocketTCP>> Clients;
+
+Reactor *reactor;
+
+/**
+ * Echoes back everything received, closes the connection on hang-up or errors.
+ */
+void on_client (Socket *socket, int events, void *data)
+{
+    SocketTCP *client = (SocketTCP *)socket;
+    Clients *clients = (Clients *)data;
+    char buffer[4096];
+
+    if (events & EV_READ)
+    {
+        int n;
+        while ((n = client->recv(buffer, sizeof(buffer))) > 0)
+            client->write(buffer, n);
+    }
+
+    if (events & (EV_HANGUP | EV_ERROR)) {
+        reactor->remove(client);
+        clients->erase(client->socket);
+    }
+}
+
+/**
+ * Accepts all pending connections.
+ */
+void on_accept (Socket *socket, int events, void *data)
+{
+    SocketTCP *server = (SocketTCP *)socket;
+    Clients *clients = (Clients *)data;
+
+    while (true)
+    {
+        auto conn = server->accept();
+        if (!conn) break;
+
+        reactor->add(conn.get(), EV_READ, on_client, clients);
+        (*clients)[conn->socket] = conn;
+    }
+}
+
+/**
+ */
+void test()
+{
+    // Allow as many connections as the hard limit permits.
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    SocketTCP socket;
+    if (!socket.bind(new SockAddrIP4(2000)) || !socket.listen(4096)) {
+        cout << "Error: Unable to listen on port 2000" << endl;
+        return;
+    }
+
+    Clients clients;
+    Reactor r;
+    reactor = &r;
+    r.add(&socket, EV_READ, on_accept, &clients);
+
+    cout << "\e[32m[Listening on " << socket.local << ", up to " << limit.rlim_cur << " descriptors]\e[0m" << endl;
+
+    signal(SIGINT, [](int) {
+        reactor->stop();
+    });
+
+    r.run();
+
+    for (auto& i : clients)
+        r.remove(i.second.get());
+
+    cout << "\e[32m[Exiting]\e[0m" << endl;
+}
+
+/**
+ */
+int main (int argc, const char *argv[])
+{
+    auto n = asr::memblocks;
+
+    test();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
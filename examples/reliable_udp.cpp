@@ -0,0 +1,385 @@
+#include <asr/socket-addr-ip4>
+#include <asr/reliable-udp>
+#include <asr/data-schema-reader>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <map>
+#include <random>
+
+using namespace asr;
+using namespace std;
+
+int num_messages = 20000;
+int num_frames = 200000;
+double loss = 0.02;
+int latency = 2;
+int pause_ms = 3000;
+
+/**
+ * Link between both channels that drops packets and delivers the rest after a latency with some jitter (so they may
+ * also arrive out of order), sending them from its own thread.
+ */
+class LossyLink
+{
+    private:
+
+    struct Packet
+    {
+        SocketUDP *socket;
+        SockAddr *remote;
+        string data;
+    };
+
+    mutex lock;
+    condition_variable changed;
+    multimap<chrono::steady_clock::time_point, Packet> queue;
+    minstd_rand random;
+    bool stop = false;
+    thread worker;
+
+    void run()
+    {
+        unique_lock<mutex> guard (lock);
+        while (!stop || !queue.empty())
+        {
+            if (queue.empty()) {
+                changed.wait(guard);
+                continue;
+            }
+
+            auto first = queue.begin();
+            if (first->first > chrono::steady_clock::now()) {
+                changed.wait_until(guard, first->first);
+                continue;
+            }
+
+            Packet packet = std::move(first->second);
+            queue.erase(first);
+
+            guard.unlock();
+            packet.socket->send(packet.remote, packet.data.data(), packet.data.size());
+            guard.lock();
+        }
+    }
+
+    public:
+
+    long dropped = 0;
+
+    LossyLink() : random(12345), worker(&LossyLink::run, this) { }
+
+    ~LossyLink() {
+        {
+            lock_guard<mutex> guard (lock);
+            stop = true;
+        }
+
+        changed.notify_one();
+        worker.join();
+    }
+
+    void push(SocketUDP *socket, SockAddr *remote, const char *data, int length)
+    {
+        lock_guard<mutex> guard (lock);
+        if (uniform_real_distribution<double>(0, 1)(random) < loss) {
+            dropped++;
+            return;
+        }
+
+        int delay = latency * 1000 + (int)(random() % (latency * 500 + 1));
+        queue.emplace(chrono::steady_clock::now() + chrono::microseconds(delay), Packet{ socket, remote, string(data, length) });
+        changed.notify_one();
+    }
+};
+
+/**
+ * Channel whose packets go through the lossy link.
+ */
+class LossyChannel : public ReliableChannel
+{
+    private:
+
+    LossyLink *link;
+    ptr<SocketUDP> socket;
+    ptr<SockAddr> remote;
+
+    protected:
+
+    int transmit(const char *packet, int length) override {
+        link->push(socket.get(), remote.get(), packet, length);
+        return length;
+    }
+
+    public:
+
+    LossyChannel(LossyLink *link, ptr<SocketUDP> socket, ptr<SockAddr> remote)
+        : ReliableChannel(socket, remote), link(link), socket(socket), remote(remote) { }
+
+    /**
+     * Processes acknowledgements until everything sent was acknowledged.
+     */
+    bool drain(int timeout)
+    {
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+        while (pending() > 0 && !is_broken() && chrono::steady_clock::now() < deadline) {
+            receive();
+            int next = update();
+            socket->is_readable(next < 0 || next > 10 ? 10 : next);
+        }
+
+        return pending() == 0;
+    }
+};
+
+/**
+ * Record streamed through the channel, same layout as the header of examples/fcgi_codec.
+ */
+class Header
+{
+    public:
+
+    unsigned int signature = 0;
+    int version = 0;
+    unsigned int checksum = 0;
+};
+
+/**
+ * Creates two sockets on loopback and the channels between them.
+ */
+struct Link
+{
+    LossyLink link;
+    ptr<SocketUDP> a, b;
+    ptr<LossyChannel> sender, receiver;
+
+    Link()
+    {
+        a = new SocketUDP(new SockAddrIP4("127.0.0.1", 0));
+        b = new SocketUDP(new SockAddrIP4("127.0.0.1", 0));
+
+        ptr<SockAddr> addr_a = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)a->local.get())->get_port());
+        ptr<SockAddr> addr_b = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)b->local.get())->get_port());
+
+        sender = new LossyChannel(&link, a, addr_b);
+        receiver = new LossyChannel(&link, b, addr_a);
+    }
+};
+
+/**
+ * Sends numbered messages and checks that all arrive once and in order.
+ */
+void test_messages()
+{
+    Link link;
+    LossyChannel *sender = link.sender.get();
+    LossyChannel *receiver = link.receiver.get();
+    atomic<bool> done (false);
+
+    auto t0 = chrono::steady_clock::now();
+
+    thread producer ([&]() {
+        char message[1000] = {0};
+        for (int i = 0; i < num_messages; i++)
+        {
+            Buffer::write_uint32be_to(message, i);
+            while (sender->send(message, sizeof(message)) == IO_WOULD_BLOCK)
+                if (!sender->wait_writeable(1000)) return;
+        }
+
+        sender->drain(5000);
+        done = true;
+    });
+
+    int received = 0, out_of_order = 0;
+    char message[1200];
+    while (received < num_messages && !receiver->is_broken())
+    {
+        int n = receiver->recv(message, sizeof(message));
+        if (n > 0) {
+            if ((uint32_t)Buffer::read_uint32be_from(message) != (uint32_t)received) out_of_order++;
+            received++;
+        }
+        else if (!receiver->wait_readable(1000))
+            break;
+    }
+
+    // Keeps acknowledging until the sender saw everything.
+    while (!done) {
+        receiver->receive();
+        receiver->update();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    producer.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    const ReliableStats& s = sender->stats();
+    const ReliableStats& r = receiver->stats();
+    cout << "messages: " << received << " of " << num_messages << " delivered" << (out_of_order ? " \e[91mout of order\e[0m" : " in order")
+         << ", " << (int)(received / secs) << " msg/s" << endl;
+    cout << "          " << link.link.dropped << " packets dropped, " << s.retransmits << " timer and " << s.fast_retransmits
+         << " fast retransmits, " << r.duplicates << " duplicates, srtt " << s.srtt / 1000.0 << " ms" << endl;
+    cout << "          " << r.received << " data packets acknowledged with " << r.acks_sent << " acks" << endl;
+}
+
+/**
+ * Streams records through buffers over the channel and decodes them with the schema interpreter.
+ */
+void test_records()
+{
+    Link link;
+    LossyChannel *sender = link.sender.get();
+    LossyChannel *receiver = link.receiver.get();
+    atomic<bool> done (false);
+
+    auto t0 = chrono::steady_clock::now();
+
+    thread producer ([&]() {
+        OReliableBuffer output (sender);
+        for (int i = 0; i < num_frames; i++) {
+            output.write_uint32be(0x00DEAD00);
+            output.write_uint8(1 + (i & 1));
+            output.write_uint16be(i & 0xFFFF);
+        }
+
+        output.flush();
+        sender->drain(5000);
+        done = true;
+    });
+
+    DataSchema<Header> schema;
+    schema
+        .uint32be(&Header::signature)
+            ->throws(0, "invalid signature")
+            ->when(0x00DEAD00)->end()
+        ->int8(&Header::version)
+            ->throws(1, "invalid version")
+            ->when(1)->end()
+            ->when(2)->end()
+        ->uint16be(&Header::checksum)
+    ;
+
+    IReliableBuffer input (receiver);
+    DataSchemaReader<Header> reader (&schema, &input);
+
+    int frames = 0;
+    unsigned int sum = 0, expected = 0;
+    for (int i = 0; i < num_frames; i++)
+        expected += i & 0xFFFF;
+
+    while (frames < num_frames)
+    {
+        auto msg = reader.feed();
+        if (msg != nullptr) {
+            sum += msg->checksum;
+            frames++;
+        }
+        else if (!input.refill() && !receiver->wait_readable(1000))
+            break;
+    }
+
+    while (!done) {
+        receiver->receive();
+        receiver->update();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    producer.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "records : " << frames << " decoded, " << (int)(frames / secs / 1000) << "k records/s"
+         << (sum == expected ? "" : " \e[91m(checksum mismatch)\e[0m") << endl;
+}
+
+/**
+ * Lets the receiver stop reading for a while (still processing packets) with short timeouts that would soon break the
+ * channel if the sender kept retransmitting, then checks that everything arrives once it reads again.
+ */
+void test_slow_reader()
+{
+    Link link;
+    LossyChannel *sender = link.sender.get();
+    LossyChannel *receiver = link.receiver.get();
+    atomic<bool> done (false);
+
+    for (LossyChannel *channel : { sender, receiver }) {
+        channel->max_rto = 100;
+        channel->max_retries = 4;
+    }
+
+    int count = 2000;
+    thread producer ([&]() {
+        char message[100] = {0};
+        for (int i = 0; i < count && !sender->is_broken(); i++)
+        {
+            Buffer::write_uint32be_to(message, i);
+            while (sender->send(message, sizeof(message)) == IO_WOULD_BLOCK && !sender->is_broken())
+                sender->wait_writeable(100);
+        }
+
+        sender->drain(5000);
+        done = true;
+    });
+
+    auto pause = chrono::steady_clock::now() + chrono::milliseconds(pause_ms);
+    while (chrono::steady_clock::now() < pause) {
+        receiver->receive();
+        receiver->update();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    int received = 0, out_of_order = 0;
+    char message[1200];
+    while (received < count && !receiver->is_broken())
+    {
+        int n = receiver->recv(message, sizeof(message));
+        if (n > 0) {
+            if ((uint32_t)Buffer::read_uint32be_from(message) != (uint32_t)received) out_of_order++;
+            received++;
+        }
+        else if (!receiver->wait_readable(1000))
+            break;
+    }
+
+    while (!done) {
+        receiver->receive();
+        receiver->update();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    producer.join();
+
+    const ReliableStats& s = sender->stats();
+    cout << "slow    : " << received << " of " << count << " delivered after a " << pause_ms << " ms pause"
+         << (out_of_order ? " \e[91mout of order\e[0m" : "") << (sender->is_broken() ? " \e[91m(sender broken)\e[0m" : "")
+         << ", " << s.retransmits << " timer retransmits, " << s.probes << " window probes, "
+         << receiver->stats().dropped << " dropped beyond the window" << endl;
+}
+
+/**
+ * Usage: reliable_udp [loss-percent] [latency-ms] [messages]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) loss = atof(argv[1]) / 100;
+    if (argc > 2) latency = atoi(argv[2]);
+    if (argc > 3) num_messages = atoi(argv[3]);
+
+    cout << "\e[90mLoss " << loss * 100 << "%, latency " << latency << " ms plus jitter\e[0m" << endl;
+
+    auto n = asr::memblocks;
+
+    test_messages();
+    test_records();
+    test_slow_reader();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-tcp>
+#include <asr/ifilebuffer>
+#include <asr/splicer>
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+
+using namespace asr;
+using namespace std;
+
+long file_size = 64 << 20;
+
+/**
+ * Returns a connected pair of non-blocking sockets, accepted from the given listener.
+ */
+bool connect_pair (SocketTCP *listener, ptr<SocketTCP> &a, ptr<SocketTCP> &b)
+{
+    a = new SocketTCP();
+    if (!a->connect(new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)listener->local.get())->get_port())))
+        return false;
+
+    while ((b = listener->accept()) == nullptr)
+        listener->is_readable(100);
+
+    a->set_nonblocking(true);
+    b->set_nonblocking(true);
+    return true;
+}
+
+/**
+ * Reads everything available on the sink and checks the ends of each read against the pattern of the file.
+ */
+bool receive (SocketTCP *sink, long &received)
+{
+    static char buffer[65536];
+    int n;
+
+    while ((n = sink->recv(buffer, sizeof(buffer))) > 0) {
+        if (buffer[0] != (char)(received * 31 >> 8) || buffer[n-1] != (char)((received + n - 1) * 31 >> 8))
+            return false;
+
+        received += n;
+    }
+
+    return true;
+}
+
+/**
+ * Sends the file to the sink using the given mode: 0 = buffered reads, 1 = sendfile, 2 = sendfile through a proxy.
+ */
+void bench (FILE *fp, int mode)
+{
+    const char *names[] = { "buffered", "sendfile", "spliced " };
+
+    SocketTCP listener;
+    listener.bind(new SockAddrIP4("127.0.0.1", 0));
+    listener.listen();
+
+    ptr<SocketTCP> source, sink, proxy_in, proxy_out;
+    if (!connect_pair(&listener, source, proxy_in)) {
+        cout << "Error: Unable to connect" << endl;
+        return;
+    }
+
+    if (mode == 2)
+        connect_pair(&listener, proxy_out, sink);
+    else
+        sink = proxy_in;
+
+    fseek(fp, 0, SEEK_SET);
+    IFileBuffer file (fp, 65536);
+    Splicer splicer;
+
+    long sent = 0, received = 0;
+    bool ok = true;
+
+    auto t0 = chrono::steady_clock::now();
+    while (ok && received < file_size)
+    {
+        if (sent < file_size)
+        {
+            long n;
+            if (mode == 0) {
+                if (!file.bytes_available()) file.refill();
+                n = source->send(&file);
+            }
+            else
+                n = source->send_file(&file);
+
+            if (n > 0) sent += n;
+        }
+
+        if (mode == 2)
+            splicer.transfer(proxy_in.get(), proxy_out.get());
+
+        ok = receive(sink.get(), received);
+    }
+
+    auto t1 = chrono::steady_clock::now();
+    double secs = chrono::duration<double>(t1 - t0).count();
+
+    cout << names[mode] << ": " << (int)(file_size / secs / 1048576) << " MB/s";
+    if (mode == 2 && !splicer.is_zero_copy())
+        cout << " (staging buffer)";
+    if (!ok)
+        cout << " \e[91m(data mismatch)\e[0m";
+    cout << endl;
+}
+
+/**
+ * Usage: sendfile_bench [megabytes]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) file_size = atol(argv[1]) << 20;
+
+    auto n = asr::memblocks;
+
+    FILE *fp = tmpfile();
+    for (long i = 0; i < file_size; i++)
+        fputc((char)(i * 31 >> 8), fp);
+
+    bench(fp, 0);
+    bench(fp, 1);
+    bench(fp, 2);
+
+    fclose(fp);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
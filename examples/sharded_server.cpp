@@ -0,0 +1,240 @@
+#include <asr/socket-addr-ip4>
+#include <asr/sharded-listener>
+#include <asr/reactor>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <unistd.h>
+
+using namespace asr;
+using namespace std;
+
+constexpr int PORT = 2300;
+
+int num_clients = 32;
+int num_connections = 500;
+int num_shards = 0;
+
+/**
+ * Accept loop of a shard, runs in its own thread with its own reactor.
+ */
+struct Worker
+{
+    Reactor reactor;
+    SocketTCP *listener;
+    unordered_map<SOCKET, ptr<SocketTCP>> clients;
+    vector<ptr<SocketTCP>> accepted;
+    int num_accepted = 0;
+};
+
+atomic<bool> stopping;
+
+/**
+ * Echoes back everything received, drops the connection on hang-up or errors.
+ */
+void on_client (Socket *socket, int events, void *data)
+{
+    SocketTCP *client = (SocketTCP *)socket;
+    Worker *worker = (Worker *)data;
+    char buffer[256];
+
+    if (events & EV_READ)
+    {
+        int n;
+        while ((n = client->recv(buffer, sizeof(buffer))) > 0)
+            client->write(buffer, n);
+    }
+
+    if (events & (EV_HANGUP | EV_ERROR)) {
+        worker->reactor.remove(client);
+        worker->clients.erase(client->socket);
+    }
+}
+
+/**
+ * Accepts the pending connections of the shard in batches.
+ */
+void on_accept (Socket *socket, int events, void *data)
+{
+    Worker *worker = (Worker *)data;
+
+    while (worker->listener->accept(worker->accepted) > 0)
+    {
+        for (auto& client : worker->accepted) {
+            worker->reactor.add(client.get(), EV_READ, on_client, worker);
+            worker->clients[client->socket] = client;
+        }
+
+        worker->num_accepted += worker->accepted.size();
+        worker->accepted.clear();
+    }
+}
+
+/**
+ */
+void serve (Worker *worker)
+{
+    worker->reactor.add(worker->listener, EV_READ, on_accept, worker);
+
+    while (!stopping)
+        worker->reactor.poll(50);
+
+    worker->reactor.remove(worker->listener);
+    for (auto& i : worker->clients)
+        worker->reactor.remove(i.second.get());
+    worker->clients.clear();
+}
+
+/**
+ * Opens connections one after the other, each one exchanges a byte and is reset (no TIME_WAIT). Uses plain sockets.
+ */
+bool client()
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    struct linger linger = { 1, 0 };
+    char c = 'x';
+
+    for (int i = 0; i < num_connections; i++)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+
+        bool ok = ::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+            && ::send(fd, &c, 1, MSG_NOSIGNAL) == 1
+            && ::recv(fd, &c, 1, 0) == 1;
+
+        ::close(fd);
+        if (!ok) return false;
+    }
+
+    return true;
+}
+
+/**
+ */
+void bench (int num_shards)
+{
+    ShardedListener listener;
+    if (!listener.listen(new SockAddrIP4("127.0.0.1", PORT), num_shards, 4096)) {
+        cout << "Error: Unable to listen on port " << PORT << endl;
+        return;
+    }
+
+    stopping = false;
+
+    vector<Worker*> workers;
+    vector<thread> threads;
+    for (int i = 0; i < listener.size(); i++) {
+        Worker *worker = new Worker();
+        worker->listener = listener.shard(i);
+        workers.push_back(worker);
+        threads.emplace_back(serve, worker);
+    }
+
+    atomic<int> failed(0);
+    vector<thread> clients;
+
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < num_clients; i++)
+        clients.emplace_back([&]() { if (!client()) failed++; });
+
+    for (auto& t : clients) t.join();
+    auto t1 = chrono::steady_clock::now();
+
+    stopping = true;
+    for (auto& t : threads) t.join();
+
+    double secs = chrono::duration<double>(t1 - t0).count();
+    cout << listener.size() << " shard(s): " << (int)(num_clients * num_connections / secs) << " conn/s, accepted";
+    for (auto worker : workers) {
+        cout << " " << worker->num_accepted;
+        delete worker;
+    }
+
+    if (failed)
+        cout << " \e[91m(" << failed << " clients failed)\e[0m";
+    cout << endl;
+}
+
+/**
+ * Copies and releases shared pointers from several threads at once, as the workers do with their sockets.
+ */
+void bench_refs (int num_threads)
+{
+    constexpr int NUM_OBJECTS = 64;
+    constexpr int NUM_ROUNDS = 20000;
+
+    struct Item { int value = 0; };
+
+    vector<thread> threads;
+    atomic<bool> started(false);
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            vector<ptr<Item>> items;
+            for (int j = 0; j < NUM_OBJECTS; j++)
+                items.push_back(new Item());
+
+            while (!started) this_thread::yield();
+
+            for (int k = 0; k < NUM_ROUNDS; k++)
+                for (auto& item : items) {
+                    ptr<Item> copy = item;
+                    copy->value++;
+                }
+        });
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    started = true;
+    for (auto& t : threads) t.join();
+    auto t1 = chrono::steady_clock::now();
+
+    double secs = chrono::duration<double>(t1 - t0).count();
+    cout << num_threads << " thread(s): " << (int)(num_threads * NUM_ROUNDS * NUM_OBJECTS / secs / 1000) << "k ptr copies/s" << endl;
+}
+
+/**
+ * Usage: sharded_server [clients] [connections_per_client] [shards]
+ * Measures the connection setup rate and the reference counting throughput with 1, 2, 4... shards, up to `shards`
+ * (default one per core).
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_clients = atoi(argv[1]);
+    if (argc > 2) num_connections = atoi(argv[2]);
+    if (argc > 3) num_shards = atoi(argv[3]);
+
+    auto n = asr::memblocks;
+
+    int max_shards = num_shards > 0 ? num_shards : thread::hardware_concurrency();
+    if (max_shards < 1) max_shards = 1;
+
+    for (int i = 1; ; i *= 2) {
+        bench(i < max_shards ? i : max_shards);
+        if (i >= max_shards) break;
+    }
+
+    cout << endl;
+    for (int i = 1; ; i *= 2) {
+        bench_refs(i < max_shards ? i : max_shards);
+        if (i >= max_shards) break;
+    }
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
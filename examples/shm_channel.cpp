@@ -0,0 +1,213 @@
+#include <asr/shm-channel>
+#include <asr/socket-unix>
+#include <asr/data-schema-reader>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace asr;
+using namespace std;
+
+int num_rounds = 100000;
+int num_frames = 1000000;
+int message_size = 64;
+
+/**
+ * Record streamed by the producer, same layout as the header of examples/fcgi_codec.
+ */
+class Header
+{
+    public:
+
+    unsigned int signature = 0;
+    int version = 0;
+    unsigned int checksum = 0;
+};
+
+/**
+ * Reads exactly `num_bytes` from the channel.
+ */
+bool read_all (ShmChannel *channel, char *buffer, int num_bytes)
+{
+    for (int received = 0; received < num_bytes; )
+    {
+        int n = channel->recv(buffer + received, num_bytes - received);
+        if (n > 0)
+            received += n;
+        else if (n == 0 || !channel->wait_readable(1000))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Reads exactly `num_bytes` from the socket.
+ */
+bool read_all (SocketUnix *socket, char *buffer, int num_bytes)
+{
+    for (int received = 0; received < num_bytes; )
+    {
+        int n = socket->recv(buffer + received, num_bytes - received);
+        if (n > 0)
+            received += n;
+        else if (!socket->is_readable(1000))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Child process: echoes messages over the socket and then over the channel, and finally produces the records.
+ */
+void peer (ptr<SocketUnix> socket)
+{
+    char buffer[4096];
+    int fds[ShmChannel::NUM_FDS], count = 0, n = 0;
+
+    for (int i = 0; i < 100 && (n = socket->recv_fds(buffer, 1, fds, count = ShmChannel::NUM_FDS)) == 0; i++)
+        socket->is_readable(10);
+
+    ShmChannel channel;
+    if (n != 1 || count != ShmChannel::NUM_FDS || !channel.attach(fds))
+        return;
+
+    for (int i = 0; i < num_rounds; i++) {
+        if (!read_all(socket.get(), buffer, message_size)) return;
+        socket->send(buffer, message_size);
+    }
+
+    for (int i = 0; i < num_rounds; i++) {
+        if (!read_all(&channel, buffer, message_size)) return;
+        channel.send(buffer, message_size);
+    }
+
+    // Written through a buffer that goes to the channel whenever it fills up.
+    OShmBuffer output (&channel);
+    for (int i = 0; i < num_frames; i++) {
+        output.write_uint32be(0x00DEAD00);
+        output.write_uint8(1 + (i & 1));
+        output.write_uint16be(i & 0xFFFF);
+    }
+
+    output.flush();
+    channel.close();
+}
+
+/**
+ */
+void test()
+{
+    ptr<SocketUnix> socket, other;
+    if (!SocketUnix::pair(socket, other)) {
+        cout << "\e[90msocketpair not supported on this system\e[0m" << endl;
+        return;
+    }
+
+    ShmChannel channel;
+    if (!channel.create()) {
+        cout << "\e[90mShared-memory channels not supported on this system\e[0m" << endl;
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        peer(other);
+        _exit(0);
+    }
+
+    // Only this copy of the descriptor is released, a shutdown would end the connection for the child too.
+    ::close(other->socket);
+    other->invalidate();
+
+    int fds[ShmChannel::NUM_FDS];
+    channel.get_fds(fds);
+    socket->send_fds("C", 1, fds, ShmChannel::NUM_FDS);
+
+    char buffer[4096];
+    memset(buffer, 'x', message_size);
+
+    // Round trips between both processes.
+    bool ok = true;
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; ok && i < num_rounds; i++)
+        ok = socket->send(buffer, message_size) == message_size && read_all(socket.get(), buffer, message_size);
+
+    auto t1 = chrono::steady_clock::now();
+    for (int i = 0; ok && i < num_rounds; i++)
+        ok = channel.send(buffer, message_size) == message_size && read_all(&channel, buffer, message_size);
+
+    if (!ok) {
+        cout << "\e[91mError: Round trip failed\e[0m" << endl;
+        channel.close();
+        waitpid(pid, nullptr, 0);
+        return;
+    }
+
+    auto t2 = chrono::steady_clock::now();
+    cout << "unix socket : " << chrono::duration<double, micro>(t1 - t0).count() / num_rounds << " us per round trip" << endl;
+    cout << "shm channel : " << chrono::duration<double, micro>(t2 - t1).count() / num_rounds << " us per round trip" << endl;
+
+    // Records decoded straight from the channel by the schema interpreter.
+    DataSchema<Header> schema;
+    schema
+        .uint32be(&Header::signature)
+            ->throws(0, "invalid signature")
+            ->when(0x00DEAD00)->end()
+        ->int8(&Header::version)
+            ->throws(1, "invalid version")
+            ->when(1)->end()
+            ->when(2)->end()
+        ->uint16be(&Header::checksum)
+    ;
+
+    IShmBuffer input (&channel);
+    DataSchemaReader<Header> reader (&schema, &input);
+
+    int frames = 0;
+    unsigned int sum = 0, expected = 0;
+    for (int i = 0; i < num_frames; i++)
+        expected += i & 0xFFFF;
+
+    auto t3 = chrono::steady_clock::now();
+    while (frames < num_frames)
+    {
+        auto msg = reader.feed();
+        if (msg != nullptr) {
+            sum += msg->checksum;
+            frames++;
+        }
+        else if (!input.refill() && (channel.is_peer_closed() || !channel.wait_readable(1000)) && !channel.bytes_available())
+            break;
+    }
+
+    auto t4 = chrono::steady_clock::now();
+    double secs = chrono::duration<double>(t4 - t3).count();
+    cout << "records     : " << frames << " decoded, " << (int)(frames / secs / 1000) << "k records/s"
+         << (sum == expected ? "" : " \e[91m(checksum mismatch)\e[0m") << endl;
+
+    channel.close();
+    waitpid(pid, nullptr, 0);
+}
+
+/**
+ * Usage: shm_channel [rounds] [frames]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_rounds = atoi(argv[1]);
+    if (argc > 2) num_frames = atoi(argv[2]);
+
+    auto n = asr::memblocks;
+
+    test();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-udp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstring>
+
+using namespace asr;
+using namespace std;
+
+int num_datagrams = 1000000;
+int datagram_size = 64;
+int batch_size = 64;
+
+atomic<bool> done;
+
+/**
+ * Sends `num_datagrams` to the given port one by one or in batches, waits when the socket buffer is full.
+ */
+void sender (int port, bool batched)
+{
+    SocketUDP socket;
+    ptr<SockAddr> remote = new SockAddrIP4("127.0.0.1", port);
+    socket.bind(new SockAddrIP4("127.0.0.1", 0));
+
+    char payload[2048];
+    memset(payload, 'x', sizeof(payload));
+
+    DatagramBatch batch (batch_size, datagram_size);
+
+    for (int sent = 0; sent < num_datagrams && !done; )
+    {
+        int n;
+        if (batched)
+        {
+            batch.clear();
+            while (!batch.is_full() && sent + batch.size() < num_datagrams) {
+                memcpy(payload, &sent, sizeof(sent));
+                batch.add(remote.get(), payload, datagram_size);
+            }
+
+            n = socket.send(batch);
+        }
+        else
+            n = socket.send(remote, payload, datagram_size) > 0 ? 1 : IO_ERROR;
+
+        if (n > 0)
+            sent += n;
+        else
+            socket.is_writeable(10);
+    }
+}
+
+/**
+ */
+void bench (bool batched)
+{
+    SocketUDP socket;
+    if (!socket.bind(new SockAddrIP4("127.0.0.1", 0))) {
+        cout << "Error: Unable to bind socket" << endl;
+        return;
+    }
+
+    // Larger receive buffer so the sender does not outrun the receiver right away.
+    int size = 8 << 20;
+    ::setsockopt(socket.socket, SOL_SOCKET, SO_RCVBUF, (const char *)&size, sizeof(size));
+
+    done = false;
+    thread t (sender, ((SockAddrIP4 *)socket.local.get())->get_port(), batched);
+
+    DatagramBatch batch (batch_size, 2048);
+    char buffer[2048];
+    int received = 0, calls = 0;
+
+    socket.set_nonblocking(true);
+
+    // Waits only when nothing is pending, stops when no datagrams arrive for a while (the rest were dropped).
+    auto t0 = chrono::steady_clock::now();
+    while (received < num_datagrams)
+    {
+        int n = batched ? socket.recv(batch) : (socket.recv(buffer, sizeof(buffer)) > 0 ? 1 : 0);
+        calls++;
+
+        if (n > 0)
+            received += n;
+        else if (!socket.is_readable(200))
+            break;
+    }
+
+    auto t1 = chrono::steady_clock::now();
+
+    done = true;
+    t.join();
+
+    double secs = chrono::duration<double>(t1 - t0).count();
+    cout << (batched ? "batched" : "single ") << ": " << (int)(received / secs / 1000) << "k datagrams/s, "
+         << (double)received / calls << " per call, " << num_datagrams - received << " dropped" << endl;
+}
+
+/**
+ * Usage: udp_batch_bench [datagrams] [datagram_size] [batch_size]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_datagrams = atoi(argv[1]);
+    if (argc > 2) datagram_size = atoi(argv[2]);
+    if (argc > 3) batch_size = atoi(argv[3]);
+
+    auto n = asr::memblocks;
+
+    bench(false);
+    bench(true);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
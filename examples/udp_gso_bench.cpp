@@ -0,0 +1,114 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-udp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstring>
+
+using namespace asr;
+using namespace std;
+
+int num_datagrams = 500000;
+int datagram_size = 1400;
+
+atomic<bool> done;
+
+/**
+ * Sends `num_datagrams` to the given port one by one or as segmented runs, waits when the socket buffer is full.
+ */
+void sender (int port, bool offload)
+{
+    SocketUDP socket;
+    ptr<SockAddr> remote = new SockAddrIP4("127.0.0.1", port);
+    socket.bind(new SockAddrIP4("127.0.0.1", 0));
+
+    static char payload[65536];
+    memset(payload, 'x', sizeof(payload));
+
+    int total = num_datagrams * datagram_size;
+    int run = offload ? sizeof(payload) / datagram_size * datagram_size : datagram_size;
+
+    for (int sent = 0; sent < total && !done; )
+    {
+        int length = total - sent < run ? total - sent : run;
+        int n = offload
+            ? socket.send_segments(remote, payload, length, datagram_size)
+            : socket.send(remote, payload, length);
+
+        if (n > 0)
+            sent += n;
+        else
+            socket.is_writeable(10);
+    }
+}
+
+/**
+ */
+void bench (bool offload)
+{
+    SocketUDP socket;
+    if (!socket.bind(new SockAddrIP4("127.0.0.1", 0))) {
+        cout << "Error: Unable to bind socket" << endl;
+        return;
+    }
+
+    if (offload && !socket.set_gro(true)) {
+        cout << "\e[90mUDP_GRO not supported on this system\e[0m" << endl;
+        return;
+    }
+
+    int size = 8 << 20;
+    ::setsockopt(socket.socket, SOL_SOCKET, SO_RCVBUF, (const char *)&size, sizeof(size));
+    socket.set_nonblocking(true);
+
+    done = false;
+    thread t (sender, ((SockAddrIP4 *)socket.local.get())->get_port(), offload);
+
+    static char buffer[65536];
+    int received = 0, calls = 0;
+
+    // Waits only when nothing is pending, stops when no datagrams arrive for a while (the rest were dropped).
+    auto t0 = chrono::steady_clock::now();
+    while (received < num_datagrams)
+    {
+        int segment_size;
+        int n = socket.recv_segments(nullptr, buffer, sizeof(buffer), segment_size);
+        calls++;
+
+        if (n > 0)
+            received += (n + segment_size - 1) / segment_size;
+        else if (!socket.is_readable(200))
+            break;
+    }
+
+    auto t1 = chrono::steady_clock::now();
+
+    done = true;
+    t.join();
+
+    double secs = chrono::duration<double>(t1 - t0).count();
+    cout << (offload ? "gso/gro" : "plain  ") << ": " << (int)(received / secs / 1000) << "k datagrams/s, "
+         << (int)((double)received * datagram_size / secs / 1048576) << " MB/s, " << (double)received / calls
+         << " per call, " << num_datagrams - received << " dropped" << endl;
+}
+
+/**
+ * Usage: udp_gso_bench [datagrams] [datagram_size]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_datagrams = atoi(argv[1]);
+    if (argc > 2) datagram_size = atoi(argv[2]);
+
+    auto n = asr::memblocks;
+
+    bench(false);
+    bench(true);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
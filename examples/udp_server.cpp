@@ -1,18 +1,41 @@
 #include <asr/socket-addr-ip6>
 #include <asr/socket-addr-ip4>
 #include <asr/socket-udp>
+#include <asr/reactor>
 #include <csignal>
+#include <cstring>
 #include <iostream>
-#include <unistd.h>
 
 using namespace asr;
 using namespace std;
 
-bool stop = false;
+Reactor *reactor;
 
 /**
+ * Answers every datagram waiting on the socket.
  */
-void test()
+void on_datagram (Socket *socket, int events, void *data)
+{
+    SocketUDP *udp = (SocketUDP *)socket;
+    char buffer[1024];
+
+    int n;
+    while ((n = udp->recv(buffer, sizeof(buffer)-8)) > 0)
+    {
+        buffer[n] = 0;
+        cout << "\e[90m" << udp->remote << "\e[0m: " << buffer << endl;
+
+        if (strcmp(buffer, "stop"))
+            strcat(buffer, " - ACK");
+
+        udp->send(buffer);
+    }
+}
+
+/**
+ * Serves from a reactor, spinning for `spin` microseconds before each blocking wait.
+ */
+void test(int spin)
 {
     SocketUDP socket;
     if (!socket.bind(new SockAddrIP4(2000))) {
@@ -25,41 +48,33 @@ void test()
         return;
     }
 
-    cout << "\e[32m[Waiting on " << socket.local << "]\e[0m" << endl;
+    Reactor r;
+    reactor = &r;
+    r.spin_budget = spin;
+    r.add(&socket, EV_READ, on_datagram);
+
+    cout << "\e[32m[Waiting on " << socket.local << (spin ? ", busy polling" : "") << "]\e[0m" << endl;
 
     signal(SIGINT, [](int) {
-        stop = true;
+        reactor->stop();
     });
 
-    socket.set_nonblocking(true);
-
-    char buffer[1024];
-    while (!stop)
-    {
-        buffer[socket.recv(buffer, sizeof(buffer)-1)] = 0;
-        if (!buffer[0]) {
-            usleep(1000);
-            continue;
-        }
-
-        cout << "\e[90m" << socket.remote << "\e[0m: " << buffer << endl;
-
-        if (strcmp(buffer, "stop"))
-            strcat(buffer, " - ACK");
-
-        socket.send(buffer);
-    }
+    r.run();
+    r.remove(&socket);
 
-    cout << "\e[32m[Exiting]\e[0m" << endl;
+    const ReactorStats& stats = r.stats();
+    cout << "\e[32m[Exiting]\e[0m \e[90m" << (int)(stats.spin_ratio() * 100) << "% spinning, " << (int)(stats.idle_ratio() * 100)
+         << "% idle, " << (int)(stats.spin_hit_ratio() * 100) << "% of the polls woken while spinning\e[0m" << endl;
 }
 
 /**
+ * Usage: udp_server [spin-microseconds]
  */
 int main (int argc, const char *argv[])
 {
     auto n = asr::memblocks;
 
-    test();
+    test(argc > 1 ? atoi(argv[1]) : 0);
 
     asr::refs::shutdown();
     if (asr::memblocks != n)
@@ -0,0 +1,138 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-udp>
+#include <asr/datagram-batch>
+#include <asr/session-table>
+#include <unordered_map>
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace asr;
+using namespace std;
+
+int num_peers = 100000;
+int num_lookups = 2000000;
+
+/**
+ * State kept by the server for each client.
+ */
+struct Peer
+{
+    int datagrams = 0;
+    int bytes = 0;
+};
+
+/**
+ * Clients send datagrams to a server that tracks them per peer, reading them in batches.
+ */
+void test_server()
+{
+    SocketUDP server (new SockAddrIP4("127.0.0.1", 0));
+    server.set_nonblocking(true);
+    ptr<SockAddr> addr = new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)server.local.get())->get_port());
+
+    const int num_clients = 8, per_client = 100;
+    SocketUDP clients[num_clients];
+    for (int i = 0; i < num_clients; i++)
+        clients[i].bind(new SockAddrIP4("127.0.0.1", 0));
+
+    SessionTable<Peer> sessions;
+    DatagramBatch batch;
+    int received = 0;
+
+    for (int k = 0; k < per_client; k++)
+    {
+        for (int i = 0; i < num_clients; i++)
+            clients[i].send(addr, "datagram", 8);
+
+        while (received < (k + 1) * num_clients && server.is_readable(1000))
+        {
+            int n = server.recv(batch);
+            for (int i = 0; i < n; i++) {
+                Peer *peer = sessions.get(batch.remote(i));
+                peer->datagrams++;
+                peer->bytes += batch.length(i);
+            }
+
+            received += n > 0 ? n : 0;
+        }
+    }
+
+    int complete = 0;
+    sessions.each([](const SockAddr *addr, Peer& peer, void *data) {
+        if (peer.datagrams == 100) (*(int *)data)++;
+    }, &complete);
+
+    cout << "server  : " << received << " datagrams from " << sessions.size() << " peers, " << complete << " complete" << endl;
+}
+
+/**
+ * Compares lookups by hashed address against a map keyed by the bytes of the address.
+ */
+void bench_lookup()
+{
+    vector<ptr<SockAddr>> addrs;
+    for (int i = 0; i < num_peers; i++) {
+        SockAddrIP4 *addr = new SockAddrIP4();
+        addr->set_address_int(0x0A000000 + i / 16);
+        addr->set_port(10000 + i % 16);
+        addrs.push_back(addr);
+    }
+
+    SessionTable<Peer> sessions (num_peers);
+    unordered_map<string, Peer> map;
+    for (auto& addr : addrs) {
+        sessions.get(addr.get());
+        map[string((const char *)&addr->data, addr->length)];
+    }
+
+    // The lookups walk the peers in a scattered order, as datagrams arrive.
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < num_lookups; i++)
+        sessions.find(addrs[(i * 7919L) % num_peers].get())->datagrams++;
+
+    auto t1 = chrono::steady_clock::now();
+    for (int i = 0; i < num_lookups; i++) {
+        SockAddr *addr = addrs[(i * 7919L) % num_peers].get();
+        map[string((const char *)&addr->data, addr->length)].datagrams++;
+    }
+
+    auto t2 = chrono::steady_clock::now();
+    cout << "table   : " << chrono::duration<double, nano>(t1 - t0).count() / num_lookups << " ns per lookup (" << num_peers << " peers)" << endl;
+    cout << "map     : " << chrono::duration<double, nano>(t2 - t1).count() / num_lookups << " ns per lookup (string key)" << endl;
+
+    // Peers that stop sending are dropped, the rest are kept.
+    sessions.idle_timeout = 50;
+    this_thread::sleep_for(chrono::milliseconds(100));
+    for (int i = 0; i < num_peers / 2; i++)
+        sessions.get(addrs[i].get());
+
+    int expired = sessions.expire();
+    bool ok = sessions.size() == num_peers / 2;
+    for (int i = 0; ok && i < num_peers; i++)
+        ok = (sessions.find(addrs[i].get()) != nullptr) == (i < num_peers / 2);
+
+    cout << "expire  : " << expired << " idle sessions removed, " << sessions.size() << " kept"
+         << (ok ? "" : " \e[91m(table inconsistent)\e[0m") << endl;
+}
+
+/**
+ * Usage: udp_sessions [peers] [lookups]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_peers = atoi(argv[1]);
+    if (argc > 2) num_lookups = atoi(argv[2]);
+
+    auto n = asr::memblocks;
+
+    test_server();
+    bench_lookup();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-unix>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace asr;
+using namespace std;
+
+int num_rounds = 50000;
+int message_size = 64;
+
+/**
+ * Connects a client to the listener and accepts it, both ends non-blocking.
+ */
+template<class T>
+bool connect_pair (T &listener, ptr<SockAddr> addr, ptr<T> &a, ptr<T> &b)
+{
+    a = new T();
+    if (!a->connect(addr))
+        return false;
+
+    while ((b = listener.accept()) == nullptr)
+        listener.is_readable(100);
+
+    b->set_nonblocking(true);
+    return true;
+}
+
+/**
+ * Reads exactly `num_bytes`, waiting when nothing is available.
+ */
+bool read_all (SocketTCP *socket, char *buffer, int num_bytes)
+{
+    for (int received = 0; received < num_bytes; )
+    {
+        int n = socket->recv(buffer + received, num_bytes - received);
+        if (n > 0)
+            received += n;
+        else if (!socket->is_readable(1000))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Bounces a message between both ends and returns the average round trip (microseconds).
+ */
+double ping_pong (SocketTCP *a, SocketTCP *b)
+{
+    char buffer[4096];
+    memset(buffer, 'x', message_size);
+
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < num_rounds; i++)
+    {
+        if (a->send(buffer, message_size) != message_size || !read_all(b, buffer, message_size))
+            return -1;
+
+        if (b->send(buffer, message_size) != message_size || !read_all(a, buffer, message_size))
+            return -1;
+    }
+
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / num_rounds;
+}
+
+/**
+ */
+void bench_latency()
+{
+    {
+        SocketTCP listener;
+        listener.bind(new SockAddrIP4("127.0.0.1", 0));
+        listener.listen();
+
+        ptr<SocketTCP> a, b;
+        if (connect_pair(listener, new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)listener.local.get())->get_port()), a, b))
+            cout << "tcp     : " << ping_pong(a.get(), b.get()) << " us per round trip" << endl;
+    }
+
+    {
+        SocketUnix listener;
+        ptr<SockAddr> addr = new SockAddrUnix("@asr-unix-socket-example");
+        listener.bind(addr);
+        listener.listen();
+
+        ptr<SocketUnix> a, b;
+        if (connect_pair(listener, addr, a, b))
+            cout << "unix    : " << ping_pong(a.get(), b.get()) << " us per round trip" << endl;
+    }
+}
+
+/**
+ * Passes the descriptor of a temporary file to the other end, which writes through it.
+ */
+void test_fd_passing()
+{
+    ptr<SocketUnix> a, b;
+    if (!SocketUnix::pair(a, b)) {
+        cout << "\e[90msocketpair not supported on this system\e[0m" << endl;
+        return;
+    }
+
+    FILE *fp = tmpfile();
+    int fd = fileno(fp);
+
+    if (a->send_fds("F", 1, &fd, 1) != 1) {
+        cout << "\e[91mUnable to pass descriptor\e[0m" << endl;
+        fclose(fp);
+        return;
+    }
+
+    char buffer[16];
+    int fds[4], count = 4, n = 0;
+    for (int i = 0; i < 100 && (n = b->recv_fds(buffer, sizeof(buffer), fds, count)) == 0; i++)
+        b->is_readable(10);
+
+    bool ok = n == 1 && count == 1 && fds[0] != fd;
+    if (ok) {
+        ok = ::write(fds[0], "hello", 5) == 5;
+        ::close(fds[0]);
+    }
+
+    char contents[8] = {0};
+    fseek(fp, 0, SEEK_SET);
+    ok = ok && fread(contents, 1, 5, fp) == 5 && !strcmp(contents, "hello");
+    fclose(fp);
+
+    cout << "fd pass : " << (ok ? "file written through the received descriptor" : "\e[91mfailed\e[0m") << endl;
+}
+
+/**
+ * Exchanges datagrams between two named sockets.
+ */
+void test_datagrams()
+{
+    SocketUnixDgram server (new SockAddrUnix("@asr-unix-dgram-server"));
+    SocketUnixDgram client (new SockAddrUnix("@asr-unix-dgram-client"));
+
+    ptr<SockAddr> addr = new SockAddrUnix("@asr-unix-dgram-server");
+    char buffer[64];
+    int received = 0;
+
+    for (int i = 0; i < 10; i++) {
+        client.send(addr, "ping", 4);
+        if (server.recv(buffer, sizeof(buffer)) == 4)
+            received++;
+    }
+
+    cout << "dgram   : " << received << " of 10 datagrams received, last from " << server.remote << endl;
+}
+
+/**
+ * Binding a path replaces a socket file left by a closed socket, but not the file of a live one or a regular file.
+ */
+void test_stale_path()
+{
+    const char *path = "/tmp/asr-unix-socket-example.sock";
+    ptr<SockAddr> addr = new SockAddrUnix(path);
+    ::unlink(path);
+
+    // Closed without removing its file.
+    {
+        SocketUnix old;
+        old.bind(addr);
+        old.listen();
+    }
+
+    SocketUnix listener;
+    bool stale = listener.bind(addr) && listener.listen();
+
+    SocketUnix other;
+    bool live = !other.bind(addr) && access(path, F_OK) == 0;
+
+    listener.close();
+    ::unlink(path);
+
+    FILE *fp = fopen(path, "w");
+    if (fp) fclose(fp);
+
+    SocketUnix third;
+    bool file = fp != nullptr && !third.bind(addr) && access(path, F_OK) == 0;
+    ::unlink(path);
+
+    if (stale && live && file)
+        cout << "stale   : stale socket file replaced, live socket and regular file left" << endl;
+    else
+        cout << "stale   : \e[91mfailed (stale " << stale << ", live " << live << ", file " << file << ")\e[0m" << endl;
+}
+
+/**
+ * Usage: unix_socket [rounds]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_rounds = atoi(argv[1]);
+
+    auto n = asr::memblocks;
+
+    bench_latency();
+    test_fd_passing();
+    test_datagrams();
+    test_stale_path();
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-tcp>
+#include <asr/reactor>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+
+using namespace asr;
+using namespace std;
+
+int num_clients = 4;
+int num_requests = 20000;
+int window = 16;
+
+const int REQUEST_SIZE = 16;
+const int MESSAGE_SIZE = 32;
+const int MESSAGES_PER_REQUEST = 4;
+
+/**
+ * How the server writes its responses: one send per message (without Nagle's algorithm, which would hold back each
+ * response waiting for the acknowledgement of the previous one) or coalesced.
+ */
+enum Mode { DIRECT, COALESCED };
+const char *mode_names[] = { "direct   ", "coalesced" };
+
+/**
+ * Connection whose flushes are counted, each one is a single send call.
+ */
+class CountingSocket : public SocketTCP
+{
+    public:
+
+    long flushes = 0;
+
+    CountingSocket(SOCKET source) : SocketTCP(source) { }
+
+    int flush() override {
+        if (pending()) flushes++;
+        return SocketTCP::flush();
+    }
+};
+
+struct Server
+{
+    Reactor reactor;
+    SocketTCP listener;
+    unordered_map<SOCKET, ptr<CountingSocket>> clients;
+    int mode = 0;
+    long writes = 0;
+    long flushes = 0;
+    int closed = 0;
+};
+
+/**
+ * Answers each request with several small messages (i.e. a status, two data messages and an end marker), written one
+ * at a time as a handler would.
+ */
+void on_client (Socket *socket, int events, void *data)
+{
+    CountingSocket *client = (CountingSocket *)socket;
+    Server *server = (Server *)data;
+
+    if (events & EV_READ)
+    {
+        char request[REQUEST_SIZE * 64], message[MESSAGE_SIZE] = {0};
+
+        int n;
+        while ((n = client->recv(request, sizeof(request))) > 0)
+        {
+            for (int i = 0; i < n / REQUEST_SIZE; i++) {
+                for (int j = 0; j < MESSAGES_PER_REQUEST; j++) {
+                    message[0] = j;
+                    client->write(message, sizeof(message));
+                    server->writes++;
+                }
+            }
+        }
+    }
+
+    if (events & (EV_HANGUP | EV_ERROR)) {
+        server->flushes += client->flushes;
+        server->closed++;
+        server->reactor.remove(client);
+        server->clients.erase(client->socket);
+    }
+}
+
+void on_accept (Socket *socket, int events, void *data)
+{
+    Server *server = (Server *)data;
+    SOCKET fd;
+
+    while ((fd = ::accept(socket->socket, nullptr, nullptr)) != -1)
+    {
+        ptr<CountingSocket> client = new CountingSocket(fd);
+        if (server->mode == COALESCED)
+            client->set_coalescing(true);
+        else
+            client->set_nodelay(true);
+
+        server->reactor.add(client.get(), EV_READ, on_client, server);
+        server->clients[fd] = client;
+    }
+}
+
+/**
+ * Keeps `window` requests in flight and waits for all the responses to arrive.
+ */
+void run_client (int port)
+{
+    SocketTCP client;
+    if (!client.connect(new SockAddrIP4("127.0.0.1", port)))
+        return;
+
+    client.set_nonblocking(false);
+    client.set_nodelay(true);
+
+    char request[REQUEST_SIZE] = {0}, buffer[16384];
+    long sent = 0, received = 0, expected = (long)num_requests * MESSAGES_PER_REQUEST * MESSAGE_SIZE;
+
+    for (; sent < window && sent < num_requests; sent++)
+        client.send(request, sizeof(request));
+
+    while (received < expected)
+    {
+        int n = client.recv(buffer, sizeof(buffer));
+        if (n <= 0) break;
+
+        long before = received / (MESSAGES_PER_REQUEST * MESSAGE_SIZE);
+        received += n;
+        long done = received / (MESSAGES_PER_REQUEST * MESSAGE_SIZE) - before;
+
+        for (; done > 0 && sent < num_requests; done--, sent++)
+            client.send(request, sizeof(request));
+    }
+
+    client.close();
+}
+
+/**
+ * Serves `num_clients` pipelining clients from a reactor.
+ */
+void bench (Mode mode)
+{
+    Server server;
+    server.mode = mode;
+
+    server.listener.bind(new SockAddrIP4("127.0.0.1", 0));
+    server.listener.listen();
+    server.reactor.add(&server.listener, EV_READ, on_accept, &server);
+
+    int port = ((SockAddrIP4 *)server.listener.local.get())->get_port();
+
+    auto t0 = chrono::steady_clock::now();
+
+    vector<thread> threads;
+    for (int i = 0; i < num_clients; i++)
+        threads.emplace_back(run_client, port);
+
+    while (server.closed < num_clients)
+        if (server.reactor.poll(100) < 0) break;
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    for (auto& t : threads)
+        t.join();
+
+    server.reactor.remove(&server.listener);
+
+    // Without coalescing every write goes straight to the socket unless something is already queued.
+    long calls = mode == COALESCED ? server.flushes : server.writes;
+
+    cout << mode_names[mode] << ": " << (int)(num_clients * (long)num_requests / secs / 1000) << "k requests/s, "
+         << server.writes << " writes in " << calls << " send calls (" << (calls ? (double)server.writes / calls : 0) << " per call)" << endl;
+}
+
+/**
+ * Usage: write_coalescing [clients] [requests-per-client] [window]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) num_clients = atoi(argv[1]);
+    if (argc > 2) num_requests = atoi(argv[2]);
+    if (argc > 3) window = atoi(argv[3]);
+
+    auto n = asr::memblocks;
+
+    bench(DIRECT);
+    bench(COALESCED);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
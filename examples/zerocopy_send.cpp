@@ -0,0 +1,127 @@
+#include <asr/socket-addr-ip4>
+#include <asr/socket-tcp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <thread>
+
+using namespace asr;
+using namespace std;
+
+long total_size = 1024L << 20;
+int slab_size = 65536;
+int num_slabs = 32;
+
+/**
+ * Returns a connected pair of non-blocking sockets.
+ */
+bool connect_pair (ptr<SocketTCP> &a, ptr<SocketTCP> &b)
+{
+    SocketTCP listener;
+    listener.bind(new SockAddrIP4("127.0.0.1", 0));
+    listener.listen();
+
+    a = new SocketTCP();
+    if (!a->connect(new SockAddrIP4("127.0.0.1", ((SockAddrIP4 *)listener.local.get())->get_port())))
+        return false;
+
+    while ((b = listener.accept()) == nullptr)
+        listener.is_readable(100);
+
+    a->set_nonblocking(true);
+    b->set_nonblocking(true);
+    return true;
+}
+
+/**
+ * Sends `total_size` bytes from a pool of slabs, a slab is refilled only when no send references it anymore.
+ */
+void bench (bool zerocopy)
+{
+    ptr<SocketTCP> source, sink;
+    if (!connect_pair(source, sink)) {
+        cout << "Error: Unable to connect" << endl;
+        return;
+    }
+
+    if (zerocopy && !source->set_zerocopy(true)) {
+        cout << "\e[90mMSG_ZEROCOPY not supported on this system\e[0m" << endl;
+        return;
+    }
+
+    vector<char> pattern(slab_size);
+    for (int i = 0; i < slab_size; i++)
+        pattern[i] = i * 7;
+
+    vector<ptr<Buffer>> slabs;
+    for (int i = 0; i < num_slabs; i++)
+        slabs.push_back(new Buffer(slab_size));
+
+    char buffer[65536];
+    long sent = 0, received = 0;
+    int completions = 0, busy = 0;
+
+    auto t0 = chrono::steady_clock::now();
+    while (received < total_size)
+    {
+        completions += source->reap();
+
+        for (auto& slab : slabs)
+        {
+            if (sent >= total_size)
+                break;
+
+            // Still pinned by a pending zero-copy send.
+            if (slab.count() > 1) {
+                busy++;
+                continue;
+            }
+
+            if (!slab->bytes_available())
+                slab->fill(pattern.data(), slab_size);
+
+            int n = source->send_zerocopy(slab);
+            if (n <= 0) break;
+            sent += n;
+        }
+
+        int n;
+        while ((n = sink->recv(buffer, sizeof(buffer))) > 0)
+            received += n;
+    }
+
+    // Wait for the last completions before releasing the slabs (they arrive through the error queue, not as input).
+    for (int i = 0; source->zerocopy_pending() && i < 1000; i++) {
+        completions += source->reap();
+        if (source->zerocopy_pending())
+            this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    auto t1 = chrono::steady_clock::now();
+    double secs = chrono::duration<double>(t1 - t0).count();
+
+    cout << (zerocopy ? "zerocopy" : "copy    ") << ": " << (int)(total_size / secs / 1048576) << " MB/s, "
+         << completions << " completions, " << busy << " pinned slabs skipped";
+    if (source->zerocopy_copied())
+        cout << " \e[90m(kernel reported copies, expected on loopback)\e[0m";
+    cout << endl;
+}
+
+/**
+ * Usage: zerocopy_send [megabytes]
+ */
+int main (int argc, const char *argv[])
+{
+    if (argc > 1) total_size = atol(argv[1]) << 20;
+
+    auto n = asr::memblocks;
+
+    bench(false);
+    bench(true);
+
+    asr::refs::shutdown();
+    if (asr::memblocks != n)
+        cout << "\e[31mMemory leak detected: \e[91m" << asr::memsize << " bytes\e[0m\n";
+
+    return 0;
+}
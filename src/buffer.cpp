@@ -1,9 +1,39 @@
 
 #include <asr/buffer>
 #include <cstring>
+#include <bit>
 
 namespace asr {
 
+    /**
+     * Unaligned loads/stores of 32/64-bit words in little or big endian order (a single load or store plus bswap).
+     */
+    template<typename W, bool big_endian>
+    static inline W swap_word (W value)
+    {
+        if constexpr ((std::endian::native == std::endian::big) == big_endian)
+            return value;
+        else if constexpr (sizeof(W) == 8)
+            return __builtin_bswap64(value);
+        else
+            return __builtin_bswap32(value);
+    }
+
+    template<typename W, bool big_endian>
+    static inline W load_word (const char *buff)
+    {
+        W value;
+        memcpy(&value, buff, sizeof(W));
+        return swap_word<W, big_endian>(value);
+    }
+
+    template<typename W, bool big_endian>
+    static inline void store_word (char *buff, W value)
+    {
+        value = swap_word<W, big_endian>(value);
+        memcpy(buff, &value, sizeof(W));
+    }
+
     Buffer::Buffer (int buffer_size)
     {
         if (buffer_size < 16) buffer_size = 16;
@@ -288,6 +318,72 @@ namespace asr {
         buff[0] = (value >> 24) & 0xFF;
     }
 
+    bool Buffer::write_uint64 (uint64_t value)
+    {
+        char tmp[8];
+        write_uint64_to(tmp, value);
+        return fill(tmp, 8) == 8;
+    }
+
+    void Buffer::write_uint64_to (char *buff, uint64_t value) {
+        store_word<uint64_t, false>(buff, value);
+    }
+
+    bool Buffer::write_uint64be (uint64_t value)
+    {
+        char tmp[8];
+        write_uint64be_to(tmp, value);
+        return fill(tmp, 8) == 8;
+    }
+
+    void Buffer::write_uint64be_to (char *buff, uint64_t value) {
+        store_word<uint64_t, true>(buff, value);
+    }
+
+    bool Buffer::write_float32 (float value)
+    {
+        char tmp[4];
+        write_float32_to(tmp, value);
+        return fill(tmp, 4) == 4;
+    }
+
+    void Buffer::write_float32_to (char *buff, float value) {
+        store_word<uint32_t, false>(buff, std::bit_cast<uint32_t>(value));
+    }
+
+    bool Buffer::write_float32be (float value)
+    {
+        char tmp[4];
+        write_float32be_to(tmp, value);
+        return fill(tmp, 4) == 4;
+    }
+
+    void Buffer::write_float32be_to (char *buff, float value) {
+        store_word<uint32_t, true>(buff, std::bit_cast<uint32_t>(value));
+    }
+
+    bool Buffer::write_float64 (double value)
+    {
+        char tmp[8];
+        write_float64_to(tmp, value);
+        return fill(tmp, 8) == 8;
+    }
+
+    void Buffer::write_float64_to (char *buff, double value) {
+        store_word<uint64_t, false>(buff, std::bit_cast<uint64_t>(value));
+    }
+
+    bool Buffer::write_float64be (double value)
+    {
+        char tmp[8];
+        write_float64be_to(tmp, value);
+        return fill(tmp, 8) == 8;
+    }
+
+    void Buffer::write_float64be_to (char *buff, double value) {
+        store_word<uint64_t, true>(buff, std::bit_cast<uint64_t>(value));
+    }
+
     bool Buffer::write_str (const char *value, int length)
     {
         if (value == nullptr) return false;
@@ -408,6 +504,84 @@ namespace asr {
         return (int32_t)read_uint32be_from(buff);
     }
 
+    /* ********** */
+    uint64_t Buffer::read_uint64 (bool peek) {
+        char tmp[8];
+        if (drain(tmp, 8, !peek) != 8) { return 0; }
+        return read_uint64_from(tmp);
+    }
+
+    uint64_t Buffer::read_uint64_from (char *buff) {
+        return load_word<uint64_t, false>(buff);
+    }
+
+    int64_t Buffer::read_int64 (bool peek) {
+        return (int64_t)read_uint64(peek);
+    }
+
+    int64_t Buffer::read_int64_from (char *buff) {
+        return (int64_t)read_uint64_from(buff);
+    }
+
+    uint64_t Buffer::read_uint64be (bool peek) {
+        char tmp[8];
+        if (drain(tmp, 8, !peek) != 8) { return 0; }
+        return read_uint64be_from(tmp);
+    }
+
+    uint64_t Buffer::read_uint64be_from (char *buff) {
+        return load_word<uint64_t, true>(buff);
+    }
+
+    int64_t Buffer::read_int64be (bool peek) {
+        return (int64_t)read_uint64be(peek);
+    }
+
+    int64_t Buffer::read_int64be_from (char *buff) {
+        return (int64_t)read_uint64be_from(buff);
+    }
+
+    /* ********** */
+    float Buffer::read_float32 (bool peek) {
+        char tmp[4];
+        if (drain(tmp, 4, !peek) != 4) { return 0; }
+        return read_float32_from(tmp);
+    }
+
+    float Buffer::read_float32_from (char *buff) {
+        return std::bit_cast<float>(load_word<uint32_t, false>(buff));
+    }
+
+    float Buffer::read_float32be (bool peek) {
+        char tmp[4];
+        if (drain(tmp, 4, !peek) != 4) { return 0; }
+        return read_float32be_from(tmp);
+    }
+
+    float Buffer::read_float32be_from (char *buff) {
+        return std::bit_cast<float>(load_word<uint32_t, true>(buff));
+    }
+
+    double Buffer::read_float64 (bool peek) {
+        char tmp[8];
+        if (drain(tmp, 8, !peek) != 8) { return 0; }
+        return read_float64_from(tmp);
+    }
+
+    double Buffer::read_float64_from (char *buff) {
+        return std::bit_cast<double>(load_word<uint64_t, false>(buff));
+    }
+
+    double Buffer::read_float64be (bool peek) {
+        char tmp[8];
+        if (drain(tmp, 8, !peek) != 8) { return 0; }
+        return read_float64be_from(tmp);
+    }
+
+    double Buffer::read_float64be_from (char *buff) {
+        return std::bit_cast<double>(load_word<uint64_t, true>(buff));
+    }
+
     /* ********** */
     char *Buffer::read_line (char *buffer, int length, char nl)
     {
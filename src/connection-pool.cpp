@@ -0,0 +1,234 @@
+
+#include <asr/connection-pool>
+#include <chrono>
+
+namespace asr {
+
+    /* *************************************/
+    /* ConnectionPool */
+
+    /**
+     * Returns the current time of the monotonic clock in microseconds.
+     */
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    /**
+     * Readiness probe of an idle connection, it must not be readable (closed by the peer or with unexpected data) nor
+     * have an error or pending output.
+     */
+    static bool is_usable(SocketTCP *socket) {
+        return socket->is_valid() && !socket->pending() && !socket->is_readable(0) && socket->get_error() == 0;
+    }
+
+    ConnectionPool::Remote& ConnectionPool::get_remote(const ptr<SockAddr>& addr)
+    {
+        auto i = remotes.find(addr);
+        if (i != remotes.end())
+            return i->second;
+
+        // Keyed by a copy, the address of the caller may change afterwards.
+        ptr<SockAddr> key = addr->alloc();
+        key->set(addr.get());
+
+        Remote& remote = remotes[key];
+        remote.addr = key;
+        return remote;
+    }
+
+    /**
+     * Connects a new socket to the remote, counted as active. The lock is released while connecting.
+     */
+    ptr<SocketTCP> ConnectionPool::open(Remote& remote, std::unique_lock<std::mutex>& guard)
+    {
+        remote.active++;
+        guard.unlock();
+
+        ptr<SocketTCP> socket = new SocketTCP();
+        bool connected = socket->connect(remote.addr, connect_timeout);
+
+        guard.lock();
+        if (!connected) {
+            remote.active--;
+            counters.failed++;
+            released.notify_all();
+            return nullptr;
+        }
+
+        counters.created++;
+        return socket;
+    }
+
+    ptr<SocketTCP> ConnectionPool::acquire(ptr<SockAddr> addr, int timeout)
+    {
+        int64_t start = now();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+        std::unique_lock<std::mutex> guard (lock);
+        Remote& remote = get_remote(addr);
+        ptr<SocketTCP> socket;
+
+        while (socket == nullptr)
+        {
+            // Most recently released first, the probe is done without the lock.
+            while (!remote.idle.empty() && socket == nullptr)
+            {
+                ptr<SocketTCP> candidate = remote.idle.back().socket;
+                remote.idle.pop_back();
+                remote.active++;
+
+                guard.unlock();
+                bool usable = is_usable(candidate.get());
+                guard.lock();
+
+                if (usable) {
+                    socket = candidate;
+                    counters.reused++;
+                }
+                else {
+                    remote.active--;
+                    counters.stale++;
+                }
+            }
+
+            if (socket != nullptr)
+                break;
+
+            if (!max_connections || remote.active + (int)remote.idle.size() < max_connections) {
+                socket = open(remote, guard);
+                if (socket == nullptr) return nullptr;
+                break;
+            }
+
+            if (timeout < 0)
+                released.wait(guard);
+            else if (released.wait_until(guard, deadline) == std::cv_status::timeout) {
+                counters.timeouts++;
+                return nullptr;
+            }
+        }
+
+        int64_t wait = now() - start;
+        counters.acquired++;
+        counters.total_wait += wait;
+        if (wait > counters.max_wait) counters.max_wait = wait;
+
+        return socket;
+    }
+
+    void ConnectionPool::release(ptr<SocketTCP> socket, bool reusable)
+    {
+        if (socket == nullptr || socket->remote == nullptr)
+            return;
+
+        std::lock_guard<std::mutex> guard (lock);
+
+        auto i = remotes.find(socket->remote);
+        if (i == remotes.end())
+            return;
+
+        Remote& remote = i->second;
+        remote.active--;
+
+        if (reusable && socket->is_valid() && !socket->pending() && (int)remote.idle.size() < max_idle)
+            remote.idle.push_back({ socket, now() });
+        else
+            counters.closed++;
+
+        released.notify_one();
+    }
+
+    int ConnectionPool::maintain()
+    {
+        int opened = 0;
+        int64_t time = now();
+
+        std::unique_lock<std::mutex> guard (lock);
+
+        // Pointers remain valid if the table is rehashed while the lock is released.
+        std::vector<Remote *> list;
+        for (auto& i : remotes)
+            list.push_back(&i.second);
+
+        for (Remote *remote : list)
+        {
+            std::vector<Idle> kept;
+            int expired = 0;
+
+            // Oldest first, connections idle for too long are closed only while more than `min_idle` remain.
+            for (int i = 0; i < (int)remote->idle.size(); i++)
+            {
+                Idle& entry = remote->idle[i];
+
+                if (!is_usable(entry.socket.get())) {
+                    counters.stale++;
+                    continue;
+                }
+
+                if (max_idle_time && time - entry.since > max_idle_time * 1000LL
+                    && (int)remote->idle.size() - i - 1 + (int)kept.size() >= min_idle) {
+                    expired++;
+                    continue;
+                }
+
+                kept.push_back(entry);
+            }
+
+            counters.closed += expired;
+            remote->idle.swap(kept);
+
+            while ((int)remote->idle.size() < min_idle
+                && (!max_connections || remote->active + (int)remote->idle.size() < max_connections))
+            {
+                ptr<SocketTCP> socket = open(*remote, guard);
+                if (socket == nullptr) break;
+
+                // New connections go to the cold end so the warm ones keep being reused first.
+                remote->active--;
+                remote->idle.insert(remote->idle.begin(), { socket, now() });
+                released.notify_one();
+                opened++;
+            }
+        }
+
+        return opened;
+    }
+
+    void ConnectionPool::add_remote(ptr<SockAddr> addr) {
+        std::lock_guard<std::mutex> guard (lock);
+        get_remote(addr);
+    }
+
+    int ConnectionPool::idle(ptr<SockAddr> addr)
+    {
+        std::lock_guard<std::mutex> guard (lock);
+        auto i = remotes.find(addr);
+        return i == remotes.end() ? 0 : i->second.idle.size();
+    }
+
+    int ConnectionPool::active(ptr<SockAddr> addr)
+    {
+        std::lock_guard<std::mutex> guard (lock);
+        auto i = remotes.find(addr);
+        return i == remotes.end() ? 0 : i->second.active;
+    }
+
+    PoolStats ConnectionPool::stats() {
+        std::lock_guard<std::mutex> guard (lock);
+        return counters;
+    }
+
+    void ConnectionPool::clear()
+    {
+        std::lock_guard<std::mutex> guard (lock);
+        for (auto& i : remotes) {
+            counters.closed += i.second.idle.size();
+            i.second.idle.clear();
+        }
+    }
+
+};
@@ -0,0 +1,83 @@
+
+#include <asr/connector>
+
+namespace asr {
+
+    /* *************************************/
+    /* Connector */
+
+    Connector::~Connector()
+    {
+        for (auto& i : attempts) {
+            reactor->remove(i.second.socket);
+            reactor->cancel_timer(i.second.timer);
+        }
+    }
+
+    bool Connector::connect(SocketTCP *socket, ptr<SockAddr> addr, ConnectHandler *handler, void *data, int timeout,
+        const char *payload, int num_bytes)
+    {
+        int res = socket->connect_async(addr, payload != nullptr);
+        if (res == IO_ERROR)
+            return false;
+
+        if (!reactor->add(socket, EV_WRITE, on_ready, this))
+            return false;
+
+        // Fast Open sockets send the SYN (with the data) on this first write, the rest are queued until connected.
+        if (payload && socket->write(payload, num_bytes) == IO_ERROR) {
+            reactor->remove(socket);
+            return false;
+        }
+
+        int timer = reactor->add_timer(timeout, on_timeout, this);
+        attempts[socket->socket] = { socket, handler, data, timer };
+        timeouts[timer] = socket->socket;
+        return true;
+    }
+
+    bool Connector::cancel(SocketTCP *socket)
+    {
+        auto i = attempts.find(socket->socket);
+        if (i == attempts.end())
+            return false;
+
+        reactor->remove(socket);
+        reactor->cancel_timer(i->second.timer);
+        timeouts.erase(i->second.timer);
+        attempts.erase(i);
+        return true;
+    }
+
+    /**
+     * Removes an attempt and reports its result.
+     */
+    void Connector::finish(SOCKET socket, bool connected)
+    {
+        auto i = attempts.find(socket);
+        if (i == attempts.end())
+            return;
+
+        Attempt attempt = i->second;
+        attempts.erase(i);
+        timeouts.erase(attempt.timer);
+        reactor->cancel_timer(attempt.timer);
+        reactor->remove(attempt.socket);
+
+        attempt.handler(attempt.socket, connected && attempt.socket->complete_connect(), attempt.data);
+    }
+
+    void Connector::on_ready(Socket *socket, int events, void *data) {
+        ((Connector *)data)->finish(socket->socket, !(events & EV_ERROR));
+    }
+
+    void Connector::on_timeout(int id, void *data)
+    {
+        Connector *connector = (Connector *)data;
+
+        auto i = connector->timeouts.find(id);
+        if (i != connector->timeouts.end())
+            connector->finish(i->second, false);
+    }
+
+};
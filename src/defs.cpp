@@ -36,6 +36,18 @@ namespace asr
     // [13-15] padding
     static constexpr size_t HEADER_SIZE = 16;
 
+    /**
+     * Accounts for a new block, the counters are updated atomically since blocks are allocated by several threads.
+     */
+    static inline void track (uint32_t total)
+    {
+        __atomic_add_fetch(&memblocks, 1, __ATOMIC_RELAXED);
+        uint32_t size = __atomic_add_fetch(&memsize, total, __ATOMIC_RELAXED);
+
+        uint32_t peak = __atomic_load_n(&peak_memsize, __ATOMIC_RELAXED);
+        while (size > peak && !__atomic_compare_exchange_n(&peak_memsize, &peak, size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+
     void* alloc (uint32_t size)
     {
         #if ASR_TRACK_MEMORY == 1
@@ -53,11 +65,7 @@ namespace asr
             *((uint32_t*)(header + 8)) = total;
             *(header + 12) = 'A';
 
-            memblocks++;
-            memsize += total;
-            if (memsize > peak_memsize)
-                peak_memsize = memsize;
-
+            track(total);
             return user_ptr;
         #else
             return std::malloc(size);
@@ -86,8 +94,8 @@ namespace asr
             uint32_t total = *((uint32_t*)(header + 8));
 
             *(header + 12) = 'D';
-            memblocks--;
-            memsize -= total;
+            __atomic_sub_fetch(&memblocks, 1, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&memsize, total, __ATOMIC_RELAXED);
             std::free(raw);
         #else
             std::free(block);
@@ -132,11 +140,7 @@ namespace asr
         *((uint32_t*)(header + 8)) = (uint32_t)total;
         *(header + 12) = 'B';
 
-        memblocks++;
-        memsize += total;
-        if (memsize > peak_memsize)
-            peak_memsize = memsize;
-
+        track(total);
         return user_ptr;
     }
 
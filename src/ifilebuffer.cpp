@@ -47,9 +47,10 @@ namespace asr {
         this->fp = fp;
         this->fp_owned = fp_owned;
 
+        // End offset, the available data is measured from the current position.
         long pos = ftell(fp);
         fseek(fp, 0, SEEK_END);
-        fsize = ftell(fp) - pos;
+        fsize = ftell(fp);
         fseek(fp, pos, SEEK_SET);
 
         fill_request(0);
@@ -0,0 +1,160 @@
+
+#include <asr/io-engine>
+
+#if !__WIN32__
+    #include <asr/io-uring>
+#endif
+
+namespace asr {
+
+    /* *************************************/
+    /* IOEngine */
+
+    ptr<IOEngine> IOEngine::create(IOEngineType type)
+    {
+        #if !__WIN32__
+            if (type != IO_ENGINE_REACTOR)
+            {
+                UringEngine *engine = new UringEngine();
+                if (engine->is_valid())
+                    return engine;
+
+                delete engine;
+            }
+        #endif
+
+        if (type == IO_ENGINE_URING)
+            return nullptr;
+
+        return new ReactorEngine();
+    }
+
+
+    /* *************************************/
+    /* ReactorEngine */
+
+    bool ReactorEngine::watch(Socket *socket, int events, Watch watch)
+    {
+        if (socket->socket == -1)
+            return false;
+
+        auto i = watches.find(socket->socket);
+        if (i != watches.end())
+        {
+            if (watch.accept_handler) i->second.accept_handler = watch.accept_handler;
+            if (watch.recv_handler) i->second.recv_handler = watch.recv_handler;
+            if (watch.data) i->second.data = watch.data;
+            return reactor.modify(socket, events);
+        }
+
+        Watch *entry = &(watches[socket->socket] = watch);
+        if (!reactor.add(socket, events, on_ready, entry)) {
+            watches.erase(socket->socket);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ReactorEngine::accept(SocketTCP *server, AcceptHandler *handler, void *data) {
+        return watch(server, EV_READ, { this, handler, nullptr, data });
+    }
+
+    bool ReactorEngine::recv(Socket *socket, RecvHandler *handler, void *data) {
+        return watch(socket, EV_READ, { this, nullptr, handler, data });
+    }
+
+    int ReactorEngine::send(SocketTCP *socket, const char *buffer, int num_bytes)
+    {
+        // Registered without events only to get the output queue flushed.
+        if (socket->reactor != &reactor && !watch(socket, 0, { this, nullptr, nullptr, nullptr }))
+            return IO_ERROR;
+
+        return socket->write(buffer, num_bytes);
+    }
+
+    bool ReactorEngine::remove(Socket *socket)
+    {
+        watches.erase(socket->socket);
+        return reactor.remove(socket);
+    }
+
+    int ReactorEngine::poll(int timeout)
+    {
+        int n = reactor.poll(timeout);
+        if (n > 0) {
+            num_polls++;
+            num_events += n;
+        }
+
+        return n;
+    }
+
+    void ReactorEngine::on_ready(Socket *socket, int events, void *data)
+    {
+        Watch watch = *(Watch *)data;
+        ReactorEngine *engine = watch.engine;
+        SOCKET fd = socket->socket;
+
+        if (watch.accept_handler)
+        {
+            SocketTCP *server = (SocketTCP *)socket;
+            while (true)
+            {
+                auto client = server->accept();
+                if (!client) break;
+
+                watch.accept_handler(server, client, watch.data);
+            }
+
+            return;
+        }
+
+        if (!watch.recv_handler)
+            return;
+
+        SocketUDP *udp = dynamic_cast<SocketUDP *>(socket);
+        char buffer[65536];
+
+        // Read until the socket would block, the handler may remove (and destroy) the socket in between.
+        while (events & (EV_READ | EV_HANGUP | EV_ERROR))
+        {
+            int n;
+            if (udp && udp->remote != nullptr) {
+                udp->remote->length = sizeof(udp->remote->data);
+                n = ::recvfrom(fd, buffer, sizeof(buffer), 0, udp->remote->sockaddr(), &udp->remote->length);
+            }
+            else
+                n = ::recv(fd, buffer, sizeof(buffer), 0);
+
+            if (n > 0)
+            {
+                Buffer input (buffer, n, n);
+                watch.recv_handler(socket, &input, watch.data);
+
+                auto i = engine->watches.find(fd);
+                if (i == engine->watches.end() || &i->second != data)
+                    return;
+
+                continue;
+            }
+
+            #if __WIN32__
+                if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+                    return;
+            #else
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return;
+            #endif
+
+            if (n == 0 && udp)
+                return;
+
+            break;
+        }
+
+        engine->remove(socket);
+        watch.recv_handler(socket, nullptr, watch.data);
+    }
+
+};
@@ -0,0 +1,570 @@
+
+#include <asr/io-uring>
+
+#if !__WIN32__
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace asr {
+
+    /**
+     * Tags stored in the low bits of the user data of submissions.
+     */
+    static constexpr uint64_t TAG_MULTISHOT = 0;
+    static constexpr uint64_t TAG_SEND = 1;
+    static constexpr uint64_t TAG_CANCEL = 2;
+
+    /* *************************************/
+    /* UringEngine */
+
+    UringEngine::UringEngine(int entries, int num_buffers, int buffer_size)
+        : sq_local_tail(0), sq_pending(0), sqes((io_uring_sqe *)MAP_FAILED), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED),
+          buf_ring((io_uring_buf_ring *)MAP_FAILED), buf_data(nullptr), buf_count(num_buffers), buf_size(buffer_size), buf_tail(0)
+    {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CLAMP | IORING_SETUP_CQSIZE;
+        p.cq_entries = entries * 4;
+
+        fd = ::syscall(__NR_io_uring_setup, entries, &p);
+        if (fd == -1) return;
+
+        // Timed waits need IORING_ENTER_EXT_ARG (5.11), the buffer ring registration below requires 5.19.
+        if (!(p.features & IORING_FEAT_EXT_ARG)) {
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+
+        sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            if (cq_ring_size > sq_ring_size) sq_ring_size = cq_ring_size;
+            cq_ring_size = sq_ring_size;
+        }
+
+        sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (p.features & IORING_FEAT_SINGLE_MMAP)
+            cq_ring = sq_ring;
+        else
+            cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+        sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = (io_uring_sqe *)::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+        buf_ring = (io_uring_buf_ring *)::mmap(nullptr, buf_count * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED || buf_ring == MAP_FAILED) {
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+
+        sq_head = (unsigned *)((char *)sq_ring + p.sq_off.head);
+        sq_tail = (unsigned *)((char *)sq_ring + p.sq_off.tail);
+        sq_mask = (unsigned *)((char *)sq_ring + p.sq_off.ring_mask);
+        sq_array = (unsigned *)((char *)sq_ring + p.sq_off.array);
+        sq_entries = p.sq_entries;
+        sq_local_tail = *sq_tail;
+
+        cq_head = (unsigned *)((char *)cq_ring + p.cq_off.head);
+        cq_tail = (unsigned *)((char *)cq_ring + p.cq_off.tail);
+        cq_mask = (unsigned *)((char *)cq_ring + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe *)((char *)cq_ring + p.cq_off.cqes);
+
+        buf_data = (char *)asr::alloc(buf_count * buf_size);
+        for (int i = 0; i < buf_count; i++)
+            recycle(i);
+
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)buf_ring;
+        reg.ring_entries = buf_count;
+        reg.bgid = 0;
+
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+    }
+
+    UringEngine::~UringEngine()
+    {
+        if (fd != -1)
+        {
+            // Closing the ring cancels pending operations asynchronously, so cancel them first and wait for their
+            // completions, the kernel could otherwise still write into the receive buffers after they are released.
+            for (auto& i : watches) {
+                i.second->removed = true;
+                retired.insert(i.second);
+            }
+
+            watches.clear();
+            submit_scheduled();
+
+            struct io_uring_sqe *sqe = get_sqe();
+            if (sqe) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL;
+                sqe->user_data = TAG_CANCEL;
+            }
+
+            for (auto watch : std::vector<Watch*>(retired.begin(), retired.end()))
+                release(watch);
+
+            while (!retired.empty() && poll(100) > 0);
+            ::close(fd);
+        }
+
+        for (auto watch : retired) delete watch;
+
+        if (buf_data) asr::dealloc(buf_data);
+        if (buf_ring != MAP_FAILED) ::munmap(buf_ring, buf_count * sizeof(struct io_uring_buf));
+        if (sqes != MAP_FAILED) ::munmap(sqes, sqes_size);
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) ::munmap(cq_ring, cq_ring_size);
+        if (sq_ring != MAP_FAILED) ::munmap(sq_ring, sq_ring_size);
+    }
+
+    /**
+     * Returns the next free submission entry (cleared), submitting the pending ones first if less than `count`
+     * entries are free. Returns `nullptr` if the ring is still full after that.
+     */
+    struct io_uring_sqe *UringEngine::get_sqe(int count)
+    {
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (sq_local_tail - head + count > sq_entries)
+        {
+            enter(0, 0);
+            head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+            if (sq_local_tail - head + count > sq_entries)
+                return nullptr;
+        }
+
+        unsigned index = sq_local_tail & *sq_mask;
+        sq_array[index] = index;
+        sq_local_tail++;
+        sq_pending++;
+
+        struct io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    /**
+     * Submits the pending entries and optionally waits for `min_complete` completions (up to `timeout` milliseconds).
+     */
+    int UringEngine::enter(unsigned min_complete, int timeout)
+    {
+        __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+        unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+        int res;
+
+        if (min_complete && timeout >= 0)
+        {
+            struct __kernel_timespec ts;
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000;
+
+            struct io_uring_getevents_arg arg;
+            memset(&arg, 0, sizeof(arg));
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = (uint64_t)&ts;
+
+            res = ::syscall(__NR_io_uring_enter, fd, sq_pending, min_complete, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        }
+        else
+            res = ::syscall(__NR_io_uring_enter, fd, sq_pending, min_complete, flags, nullptr, 0);
+
+        if (res >= 0) {
+            sq_pending -= (unsigned)res < sq_pending ? res : sq_pending;
+            return res;
+        }
+
+        return errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY ? 0 : -1;
+    }
+
+    /**
+     * Returns the watch of a socket, optionally creating it.
+     */
+    UringEngine::Watch *UringEngine::find(Socket *socket, bool create)
+    {
+        auto i = watches.find(socket->socket);
+        if (i != watches.end())
+            return i->second;
+
+        if (!create)
+            return nullptr;
+
+        // io_uring honors O_NONBLOCK returning -EAGAIN instead of waiting for readiness itself.
+        socket->set_nonblocking(false);
+
+        Watch *watch = new Watch();
+        watch->socket = socket;
+        watch->accept_handler = nullptr;
+        watch->recv_handler = nullptr;
+        watch->data = nullptr;
+        watch->udp = dynamic_cast<SocketUDP *>(socket) != nullptr;
+        watch->armed = false;
+        watch->removed = false;
+        watch->inflight = 0;
+        watch->output = nullptr;
+        watch->sending = 0;
+        watch->sent = 0;
+        watch->send_failed = false;
+        watch->scheduled = false;
+
+        // Template for multishot recvmsg, the kernel stores the sender address before the payload.
+        memset(&watch->msg, 0, sizeof(watch->msg));
+        watch->msg.msg_namelen = sizeof(struct sockaddr_storage);
+
+        watches[socket->socket] = watch;
+        return watch;
+    }
+
+    /**
+     * Deletes a removed watch once all of its operations have completed.
+     */
+    void UringEngine::release(Watch *watch)
+    {
+        if (!watch->removed || watch->inflight)
+            return;
+
+        retired.erase(watch);
+        delete watch;
+    }
+
+    /**
+     * Submits the multishot accept or receive operation of a watch.
+     */
+    bool UringEngine::arm(Watch *watch)
+    {
+        struct io_uring_sqe *sqe = get_sqe();
+        if (!sqe) return false;
+
+        sqe->fd = watch->socket->socket;
+        sqe->user_data = (uint64_t)watch | TAG_MULTISHOT;
+
+        if (watch->accept_handler) {
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_CLOEXEC;
+        }
+        else {
+            sqe->opcode = watch->udp ? IORING_OP_RECVMSG : IORING_OP_RECV;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = 0;
+            if (watch->udp) sqe->addr = (uint64_t)&watch->msg;
+        }
+
+        watch->armed = true;
+        watch->inflight++;
+        return true;
+    }
+
+    /**
+     * Submits the contents of the output queue (both blocks if it wraps around) as a single vectored send, once the
+     * previous one has completed.
+     */
+    void UringEngine::submit_send(Watch *watch)
+    {
+        if (watch->sending || watch->removed || watch->output == nullptr)
+            return;
+
+        Span spans[2];
+        int count = watch->output->peek(spans);
+        if (!count) return;
+
+        struct io_uring_sqe *sqe = get_sqe();
+        if (!sqe) return;
+
+        for (int i = 0; i < count; i++) {
+            watch->send_iov[i].iov_base = (void *)spans[i].data;
+            watch->send_iov[i].iov_len = spans[i].length;
+        }
+
+        memset(&watch->send_msg, 0, sizeof(watch->send_msg));
+        watch->send_msg.msg_iov = watch->send_iov;
+        watch->send_msg.msg_iovlen = count;
+
+        watch->sent = 0;
+        watch->send_failed = false;
+
+        // MSG_WAITALL makes the kernel retry short sends, so the completion reports either everything or an error.
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = watch->socket->socket;
+        sqe->addr = (uint64_t)&watch->send_msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = (uint64_t)watch | TAG_SEND;
+        watch->sending++;
+        watch->inflight++;
+    }
+
+    /**
+     * Marks the output queue of a watch to be sent before the next wait for completions, so data queued by several
+     * handlers (or several chunks of the same input) in one iteration goes out in a single send.
+     */
+    void UringEngine::schedule_send(Watch *watch)
+    {
+        if (watch->scheduled)
+            return;
+
+        watch->scheduled = true;
+        watch->inflight++;
+        scheduled.push_back(watch);
+    }
+
+    /**
+     * Submits the scheduled output queues.
+     */
+    void UringEngine::submit_scheduled()
+    {
+        for (auto watch : scheduled) {
+            watch->scheduled = false;
+            watch->inflight--;
+            submit_send(watch);
+            release(watch);
+        }
+
+        scheduled.clear();
+    }
+
+    /**
+     * Returns a receive buffer to the provided buffer ring.
+     */
+    void UringEngine::recycle(int bid)
+    {
+        // Not `buf_ring->bufs`, in C++ the flexible array is placed after an empty struct and its offset is wrong.
+        struct io_uring_buf *buf = (struct io_uring_buf *)buf_ring + (buf_tail & (buf_count - 1));
+        buf->addr = (uint64_t)(buf_data + bid * buf_size);
+        buf->len = buf_size;
+        buf->bid = bid;
+
+        __atomic_store_n(&buf_ring->tail, ++buf_tail, __ATOMIC_RELEASE);
+    }
+
+    void UringEngine::complete(uint64_t user_data, int res, unsigned flags)
+    {
+        Watch *watch = (Watch *)(user_data & ~3ULL);
+        int tag = user_data & 3;
+        if (!watch || tag == TAG_CANCEL)
+            return;
+
+        bool more = flags & IORING_CQE_F_MORE;
+
+        if (tag == TAG_SEND)
+        {
+            watch->sending--;
+            if (res > 0)
+                watch->sent += res;
+            else if (res != -ECANCELED)
+                watch->send_failed = true;
+
+            if (!watch->sending)
+            {
+                watch->output->drain(watch->sent);
+
+                if (!watch->send_failed)
+                    schedule_send(watch);
+                else
+                {
+                    // The connection is unusable, drop the queue and report it through the receive handler.
+                    watch->output->drain(watch->output->bytes_available());
+
+                    if (!watch->removed && watch->recv_handler) {
+                        Socket *socket = watch->socket;
+                        remove(socket);
+                        watch->recv_handler(socket, nullptr, watch->data);
+                    }
+                }
+            }
+        }
+        else if (watch->accept_handler)
+        {
+            if (res >= 0 && watch->removed)
+                ::close(res);
+            else if (res >= 0)
+            {
+                SocketTCP *server = (SocketTCP *)watch->socket;
+
+                ptr<SockAddr> remote = server->local != nullptr ? server->local->alloc() : nullptr;
+                if (remote != nullptr)
+                    ::getpeername(res, remote->sockaddr(), &remote->length);
+
+                // Output is already coalesced per poll, Nagle would only delay the replies split across receive buffers.
+                int one = 1;
+                ::setsockopt(res, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                watch->accept_handler(server, new SocketTCP(res, remote), watch->data);
+            }
+        }
+        else
+        {
+            if (flags & IORING_CQE_F_BUFFER)
+            {
+                int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+                char *data = buf_data + bid * buf_size;
+
+                if (res > 0 && !watch->removed)
+                {
+                    if (watch->udp)
+                    {
+                        // Layout: io_uring_recvmsg_out, sender address, control data (none), payload.
+                        auto *out = (struct io_uring_recvmsg_out *)data;
+                        char *name = data + sizeof(*out);
+                        data = name + watch->msg.msg_namelen + watch->msg.msg_controllen;
+                        res = out->payloadlen;
+
+                        SocketUDP *udp = (SocketUDP *)watch->socket;
+                        if (udp->remote != nullptr) {
+                            memcpy(&udp->remote->data, name, out->namelen < sizeof(udp->remote->data) ? out->namelen : sizeof(udp->remote->data));
+                            udp->remote->length = out->namelen;
+                        }
+                    }
+
+                    Buffer input (data, res, res);
+                    watch->recv_handler(watch->socket, &input, watch->data);
+                }
+
+                recycle(bid);
+            }
+            else if (res != -ENOBUFS && res != -ECANCELED && !watch->removed && (res < 0 || !watch->udp))
+            {
+                // End of stream or error.
+                Socket *socket = watch->socket;
+                remove(socket);
+                watch->recv_handler(socket, nullptr, watch->data);
+            }
+        }
+
+        // Multishot operations end when the kernel runs out of buffers or on errors, re-arm them if still watched.
+        if (tag == TAG_MULTISHOT && !more) {
+            watch->armed = false;
+            if (!watch->removed && res != -ECANCELED && (watch->accept_handler || watch->recv_handler))
+                arm(watch);
+        }
+
+        if ((tag == TAG_MULTISHOT && !more) || tag == TAG_SEND)
+            watch->inflight--;
+
+        release(watch);
+    }
+
+    bool UringEngine::accept(SocketTCP *server, AcceptHandler *handler, void *data)
+    {
+        if (fd == -1 || server->socket == -1)
+            return false;
+
+        Watch *watch = find(server, true);
+        watch->accept_handler = handler;
+        watch->data = data;
+        return watch->armed || arm(watch);
+    }
+
+    bool UringEngine::recv(Socket *socket, RecvHandler *handler, void *data)
+    {
+        if (fd == -1 || socket->socket == -1)
+            return false;
+
+        Watch *watch = find(socket, true);
+        watch->recv_handler = handler;
+        watch->data = data;
+        return watch->armed || arm(watch);
+    }
+
+    int UringEngine::send(SocketTCP *socket, const char *buffer, int num_bytes)
+    {
+        if (fd == -1 || socket->socket == -1)
+            return IO_ERROR;
+
+        if (socket->output == nullptr)
+            socket->output = new Buffer(socket->queue_size);
+
+        Watch *watch = find(socket, true);
+        watch->output = socket->output;
+
+        int n = socket->output->fill(buffer, num_bytes);
+        schedule_send(watch);
+        return n ? n : IO_WOULD_BLOCK;
+    }
+
+    bool UringEngine::remove(Socket *socket)
+    {
+        Watch *watch = find(socket, false);
+        if (!watch) return false;
+
+        watches.erase(socket->socket);
+        watch->removed = true;
+
+        // Cancel now, the socket might be closed right after returning.
+        if (watch->armed)
+        {
+            struct io_uring_sqe *sqe = get_sqe();
+            if (sqe) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = (uint64_t)watch | TAG_MULTISHOT;
+                sqe->user_data = TAG_CANCEL;
+                enter(0, 0);
+            }
+        }
+
+        if (watch->inflight)
+            retired.insert(watch);
+        else
+            delete watch;
+
+        return true;
+    }
+
+    int UringEngine::poll(int timeout)
+    {
+        submit_scheduled();
+
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            if (enter(1, timeout) < 0)
+                return -1;
+        }
+        else if (sq_pending)
+            enter(0, 0);
+
+        int count = 0;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail)
+        {
+            struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+
+            __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+
+            complete(user_data, res, flags);
+            count++;
+
+            if (head == tail)
+                tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        }
+
+        if (count) {
+            num_polls++;
+            num_events += count;
+        }
+
+        return count;
+    }
+
+};
+
+#endif
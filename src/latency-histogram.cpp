@@ -0,0 +1,158 @@
+#include <asr/latency-histogram>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+namespace asr {
+
+    /* *************************************/
+    /* LatencyHistogram */
+
+    /**
+     * Values below 2*SUB_COUNT have a bucket each, above that each power of two is split in SUB_COUNT buckets.
+     */
+    int LatencyHistogram::bucket(int64_t value)
+    {
+        if (value < 2 * SUB_COUNT)
+            return (int)value;
+
+        if (value >= (1LL << MAX_BITS))
+            return NUM_BUCKETS - 1;
+
+        int shift = 63 - __builtin_clzll((uint64_t)value) - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + (int)(value >> shift) - SUB_COUNT;
+    }
+
+    /**
+     * Returns the middle of the range of a bucket.
+     */
+    int64_t LatencyHistogram::bucket_value(int index)
+    {
+        if (index < 2 * SUB_COUNT)
+            return index;
+
+        int shift = index / SUB_COUNT - 1;
+        int64_t low = (int64_t)(index % SUB_COUNT + SUB_COUNT) << shift;
+        return low + ((1LL << shift) - 1) / 2;
+    }
+
+    void LatencyHistogram::record(int64_t nanos)
+    {
+        if (nanos < 0) nanos = 0;
+
+        counts[bucket(nanos)]++;
+        count++;
+        total += nanos;
+
+        if (nanos < min) min = nanos;
+        if (nanos > max) max = nanos;
+    }
+
+    void LatencyHistogram::merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            counts[i] += other.counts[i];
+
+        count += other.count;
+        total += other.total;
+
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+    }
+
+    void LatencyHistogram::clear()
+    {
+        memset(counts, 0, sizeof(counts));
+        count = 0;
+        total = 0;
+        min = INT64_MAX;
+        max = 0;
+    }
+
+    int64_t LatencyHistogram::percentile(double percent) const
+    {
+        if (!count)
+            return 0;
+
+        uint64_t target = (uint64_t)(percent / 100.0 * count + 0.5);
+        if (target < 1) target = 1;
+
+        uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= target) {
+                int64_t value = bucket_value(i);
+                return value > max ? max : value < min ? min : value;
+            }
+        }
+
+        return max;
+    }
+
+    void LatencyHistogram::dump(std::ostream &os) const
+    {
+        auto us = [](int64_t nanos) { return nanos / 1000.0; };
+
+        os << std::fixed << std::setprecision(1)
+           << "n=" << count << " min " << us(get_min()) << " mean " << mean() / 1000.0
+           << " p50 " << us(percentile(50)) << " p99 " << us(percentile(99)) << " p99.9 " << us(percentile(99.9))
+           << " max " << us(max) << " us";
+
+        os.unsetf(std::ios::floatfield);
+    }
+
+    /* *************************************/
+    /* LatencyTrace */
+
+    LatencyTrace::LatencyTrace(std::initializer_list<const char *> stages) : origin(0), last(0)
+    {
+        for (const char *name : stages)
+            names.push_back(name);
+
+        this->stages.resize(names.size());
+    }
+
+    int64_t LatencyTrace::now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    void LatencyTrace::mark(int stage, int64_t time)
+    {
+        if (!time) time = now();
+
+        stages[stage].record(time - last);
+        last = time;
+
+        if (stage == (int)stages.size() - 1)
+            total.record(time - origin);
+    }
+
+    void LatencyTrace::clear()
+    {
+        for (auto &stage : stages)
+            stage.clear();
+
+        total.clear();
+    }
+
+    void LatencyTrace::dump(std::ostream &os) const
+    {
+        size_t width = 5;
+        for (auto &name : names)
+            width = name.size() > width ? name.size() : width;
+
+        for (size_t i = 0; i < stages.size(); i++) {
+            os << std::left << std::setw(width) << names[i] << std::right << " : ";
+            stages[i].dump(os);
+            os << std::endl;
+        }
+
+        os << std::left << std::setw(width) << "total" << std::right << " : ";
+        total.dump(os);
+        os << std::endl;
+    }
+
+};
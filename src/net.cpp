@@ -6,9 +6,43 @@
 #include <asr/socket>
 #include <asr/socket-tcp>
 #include <asr/socket-udp>
+#include <asr/reactor>
+#include <asr/ifilebuffer>
+#include <asr/socket-pool>
+#include <asr/socket-unix>
 
 #include <iostream>
 
+#if !__WIN32__
+    #include <poll.h>
+    #include <netinet/udp.h>
+    #include <netinet/tcp.h>
+    #include <sys/stat.h>
+#endif
+
+#if __linux__
+    #include <sys/sendfile.h>
+    #include <linux/errqueue.h>
+    #include <linux/net_tstamp.h>
+#endif
+
+#if __linux__ && !defined(SO_ZEROCOPY)
+    #define SO_ZEROCOPY 60
+#endif
+
+#if __linux__ && !defined(MSG_ZEROCOPY)
+    #define MSG_ZEROCOPY 0x4000000
+#endif
+
+#if __linux__ && !defined(UDP_SEGMENT)
+    #define UDP_SEGMENT 103
+    #define UDP_GRO 104
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 namespace asr {
 
     // When using Windows, ensures that Winsocks is properly initialized.
@@ -32,7 +66,7 @@ namespace asr {
     /* *************************************/
     /* Socket */
 
-    Socket::Socket(SOCKET source) : socket(source) {
+    Socket::Socket(SOCKET source) : timestamping(false), rx_timestamp(0), socket(source), reactor(nullptr) {
     }
 
     Socket::~Socket() {
@@ -48,6 +82,9 @@ namespace asr {
     {
         if (socket == -1) return;
 
+        if (reactor)
+            reactor->remove(this);
+
         #if __WIN32__
             if (connected)
                 ::shutdown(socket, SD_BOTH);
@@ -62,32 +99,63 @@ namespace asr {
         socket = -1;
     }
 
-    bool Socket::is_readable(int timeout) const
+    /**
+     * Waits up to `timeout` milliseconds for the socket to report any of the given poll events. Uses poll() since
+     * select() cannot handle socket numbers above FD_SETSIZE.
+     */
+    static bool wait_for(SOCKET socket, short events, int timeout)
     {
-        fd_set dset;
-        FD_ZERO(&dset);
-
-        struct timeval tm;
-        tm.tv_sec = timeout / 1000;
-        tm.tv_usec = (timeout % 1000) * 1000;
-        FD_SET(socket, &dset);
+        #if __WIN32__
+            WSAPOLLFD pfd = { socket, events, 0 };
+            return ::WSAPoll(&pfd, 1, timeout) == 1 && (pfd.revents & events);
+        #else
+            struct pollfd pfd = { socket, events, 0 };
+            return ::poll(&pfd, 1, timeout) == 1 && (pfd.revents & events);
+        #endif
+    }
 
-        int cnt = ::select(socket+1, &dset, nullptr, nullptr, &tm);
-        return cnt == 1;
+    /**
+     * Returns `true` if the last socket operation failed only because it would have blocked.
+     */
+    static bool would_block()
+    {
+        #if __WIN32__
+            return WSAGetLastError() == WSAEWOULDBLOCK;
+        #else
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        #endif
     }
 
-    bool Socket::is_writeable(int timeout) const
+    /**
+     * Accepts a connection as a non-blocking socket, returns -1 when there are no more pending connections.
+     */
+    static SOCKET accept_nonblocking(SOCKET socket, struct sockaddr_storage &addr, socklen_t &length)
     {
-        fd_set dset;
-        FD_ZERO(&dset);
+        while (true)
+        {
+            #if __WIN32__
+                SOCKET nsocket = ::accept(socket, (struct sockaddr *)&addr, &length);
+                if (nsocket != -1) {
+                    unsigned long val = 1;
+                    ::ioctlsocket(nsocket, FIONBIO, &val);
+                }
+                return nsocket;
+            #else
+                // Flags set by the same call, saves two fcntl calls per connection.
+                SOCKET nsocket = ::accept4(socket, (struct sockaddr *)&addr, &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (nsocket == -1 && (errno == EINTR || errno == ECONNABORTED))
+                    continue;
+                return nsocket;
+            #endif
+        }
+    }
 
-        struct timeval tm;
-        tm.tv_sec = timeout / 1000;
-        tm.tv_usec = (timeout % 1000) * 1000;
-        FD_SET(socket, &dset);
+    bool Socket::is_readable(int timeout) const {
+        return wait_for(socket, POLLIN, timeout);
+    }
 
-        int cnt = ::select(socket+1, nullptr, &dset, nullptr, &tm);
-        return cnt == 1;
+    bool Socket::is_writeable(int timeout) const {
+        return wait_for(socket, POLLOUT, timeout);
     }
 
     int Socket::get_error() const {
@@ -102,11 +170,115 @@ namespace asr {
         ::setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, (const char *)&val, sizeof(val));
     }
 
+    void Socket::set_reuse_port(bool value) {
+        #ifdef SO_REUSEPORT
+            int val = value ? 1 : 0;
+            ::setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, (const char *)&val, sizeof(val));
+        #endif
+    }
+
     void Socket::set_broadcast(bool value) {
         int val = value ? 1 : 0;
         ::setsockopt(socket, SOL_SOCKET, SO_BROADCAST, (const char *)&val, sizeof(val));
     }
 
+    bool Socket::set_busy_poll(int usecs)
+    {
+        #if __linux__ && defined(SO_BUSY_POLL)
+            return ::setsockopt(socket, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) == 0;
+        #else
+            return false;
+        #endif
+    }
+
+    bool Socket::set_timestamping(bool value)
+    {
+        #if __linux__
+            if (socket == -1)
+                return false;
+
+            // Software timestamps only, hardware ones are in the clock of the network card, not the system clock.
+            int flags = value ? SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE : 0;
+
+            int val = value ? 1 : 0;
+            bool ok = ::setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0
+                || ::setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &val, sizeof(val)) == 0;
+
+            if (ok) timestamping = value;
+            rx_timestamp = 0;
+            return ok;
+        #else
+            return false;
+        #endif
+    }
+
+    #if __linux__
+        /**
+         * Space for the receive timestamps of a read.
+         */
+        static constexpr int TIMESTAMP_SPACE = CMSG_SPACE(sizeof(struct scm_timestamping));
+
+        static inline int64_t to_nanos(const struct timespec &ts) {
+            return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        }
+
+        /**
+         * Returns the (software) receive timestamp of the ancillary data of a read, or zero.
+         */
+        static int64_t read_timestamp(struct msghdr *hdr)
+        {
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET)
+                    continue;
+
+                if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                    struct scm_timestamping ts;
+                    memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                    return to_nanos(ts.ts[0]);
+                }
+
+                if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                    struct timespec ts;
+                    memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                    return to_nanos(ts);
+                }
+            }
+
+            return 0;
+        }
+
+        /**
+         * Reads with the receive timestamp (recvmsg), storing it in `timestamp`.
+         */
+        static int recv_timestamped(SOCKET socket, SockAddr *remote, char *buffer, int num_bytes, int64_t &timestamp)
+        {
+            struct iovec iov = { buffer, (size_t)num_bytes };
+            alignas(struct cmsghdr) char control[TIMESTAMP_SPACE];
+
+            struct msghdr hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_iov = &iov;
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = control;
+            hdr.msg_controllen = sizeof(control);
+
+            if (remote != nullptr) {
+                hdr.msg_name = remote->sockaddr();
+                hdr.msg_namelen = remote->length;
+            }
+
+            int n = ::recvmsg(socket, &hdr, 0);
+            if (n < 0) return n;
+
+            if (remote != nullptr)
+                remote->length = hdr.msg_namelen;
+
+            timestamp = read_timestamp(&hdr);
+            return n;
+        }
+    #endif
+
     void Socket::set_nonblocking(bool value)
     {
         if (socket == -1) return;
@@ -136,14 +308,27 @@ namespace asr {
     SocketTCP::SocketTCP(SOCKET source) : Socket(source) {
         local = nullptr;
         remote = nullptr;
+        output = nullptr;
+        queue_size = 65536;
+        zerocopy_threshold = 16384;
+        coalesce_threshold = 16384;
+        zerocopy_seq = 0;
+        zerocopy = false;
+        zerocopy_copies = false;
+        coalescing = false;
         connected = false;
     }
 
-    bool SocketTCP::bind(ptr<SockAddr> addr)
+    bool SocketTCP::bind(ptr<SockAddr> addr, bool reuse_port)
     {
         if (socket == -1 && alloc(addr->get_family(), SOCK_STREAM) == -1)
             return false;
 
+        if (reuse_port) {
+            set_reuse_addr(true);
+            set_reuse_port(true);
+        }
+
         local = addr;
         if (::bind(socket, addr->sockaddr(), addr->length) == -1)
             return false;
@@ -174,48 +359,144 @@ namespace asr {
         SocketTCP *client = new SocketTCP(nsocket);
         client->remote = remote;
         client->connected = true;
+        client->timestamping = timestamping;
         return client;
     }
 
+    int SocketTCP::accept(std::vector<ptr<SocketTCP>> &clients, int max_count, SocketPool *pool)
+    {
+        if (socket == -1) return 0;
+
+        int count = 0;
+        while (count < max_count)
+        {
+            // Peer address kept on the stack, copied into the (possibly recycled) address object of the socket.
+            struct sockaddr_storage addr;
+            socklen_t length = sizeof(addr);
+
+            int nsocket = accept_nonblocking(socket, addr, length);
+            if (nsocket == -1) break;
+
+            ptr<SocketTCP> client = pool ? pool->get(nsocket) : ptr<SocketTCP>(new SocketTCP(nsocket));
+            client->connected = true;
+
+            // Inherited by the kernel from the listener.
+            client->timestamping = timestamping;
+
+            if (client->remote == nullptr || client->remote->get_family() != local->get_family())
+                client->remote = local->alloc();
+
+            std::memcpy(&client->remote->data, &addr, length);
+            client->remote->length = length;
+
+            clients.push_back(client);
+            count++;
+        }
+
+        return count;
+    }
+
+    void SocketTCP::reset(SOCKET source)
+    {
+        close();
+
+        socket = source;
+        reactor = nullptr;
+        connected = true;
+
+        if (remote != nullptr && remote.count() > 1)
+            remote = nullptr;
+
+        local = nullptr;
+        output = nullptr;
+        queue_size = 65536;
+        zerocopy_threshold = 16384;
+        zerocopy_sends.clear();
+        zerocopy_seq = 0;
+        zerocopy = false;
+        zerocopy_copies = false;
+        coalescing = false;
+        coalesce_threshold = 16384;
+        timestamping = false;
+        rx_timestamp = 0;
+    }
+
     bool SocketTCP::connect(ptr<SockAddr> addr, int timeout)
     {
-        struct timeval tv;
-        fd_set tmpset; 
+        int res = connect_async(addr);
+        if (res == IO_WOULD_BLOCK && is_writeable(timeout * 1000))
+            return complete_connect();
+
+        return res == 0;
+    }
 
+    int SocketTCP::connect_async(ptr<SockAddr> addr, bool fastopen)
+    {
         connected = false;
 
         if (socket == -1 && alloc(addr->get_family(), SOCK_STREAM) == -1)
-            return false;
+            return IO_ERROR;
 
         remote = addr;
         set_nonblocking(true);
 
-        int res = ::connect(socket, remote->sockaddr(), remote->length);
-        if (res < 0)
-        {
-            #if __WIN32__
-                if (WSAGetLastError() != WSAEWOULDBLOCK)
-                    return false;
-            #else
-                if (errno != EINPROGRESS && errno != EWOULDBLOCK)
-                    return false;
-            #endif
+        #ifdef TCP_FASTOPEN_CONNECT
+            if (fastopen) {
+                int val = 1;
+                ::setsockopt(socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, (const char *)&val, sizeof(val));
+            }
+        #endif
 
-            tv.tv_sec = 10;
-            tv.tv_usec = 0;
+        if (::connect(socket, remote->sockaddr(), remote->length) == 0) {
+            connected = true;
+            return 0;
+        }
 
-            FD_ZERO(&tmpset); 
-            FD_SET(socket, &tmpset);
+        #if __WIN32__
+            if (WSAGetLastError() == WSAEWOULDBLOCK)
+                return IO_WOULD_BLOCK;
+        #else
+            if (errno == EINPROGRESS || errno == EWOULDBLOCK)
+                return IO_WOULD_BLOCK;
+        #endif
 
-            if (::select(socket+1, nullptr, &tmpset, nullptr, &tv) > 0) {
-                if (!get_error())
-                    return connected = true;
-            }
+        return IO_ERROR;
+    }
 
+    bool SocketTCP::complete_connect()
+    {
+        if (socket == -1)
             return false;
-        }
 
-        return connected = true;
+        connected = get_error() == 0;
+        return connected;
+    }
+
+    bool SocketTCP::set_fastopen(int queue_length)
+    {
+        #ifdef TCP_FASTOPEN
+            return ::setsockopt(socket, IPPROTO_TCP, TCP_FASTOPEN, (const char *)&queue_length, sizeof(queue_length)) == 0;
+        #else
+            return false;
+        #endif
+    }
+
+    bool SocketTCP::set_nodelay(bool value)
+    {
+        int val = value ? 1 : 0;
+        return ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&val, sizeof(val)) == 0;
+    }
+
+    bool SocketTCP::set_coalescing(bool value)
+    {
+        if (socket == -1)
+            return false;
+
+        // Fails on Unix sockets, which have no Nagle delay to disable.
+        if (value) set_nodelay(true);
+
+        coalescing = value;
+        return value || flush() != IO_ERROR;
     }
 
     int SocketTCP::recv(char *buffer, int num_bytes, int buffer_space)
@@ -227,30 +508,377 @@ namespace asr {
             buffer_space = num_bytes;
 
         num_bytes = num_bytes > buffer_space ? buffer_space : num_bytes;
+
+        #if __linux__
+            if (timestamping) {
+                int n = recv_timestamped(socket, nullptr, buffer, num_bytes, rx_timestamp);
+                return n < 1 ? 0 : n;
+            }
+        #endif
+
         int n = ::recv(socket, buffer, num_bytes, 0);
         return n < 1 ? 0 : n;
     }
 
     int SocketTCP::send(const char *buffer, int num_bytes)
     {
-        if (socket == -1 || !is_writeable(0))
+        if (socket == -1)
+            return IO_ERROR;
+
+        if (num_bytes == -1)
+            num_bytes = ::strlen(buffer);
+
+        int n = ::send(socket, buffer, num_bytes, MSG_NOSIGNAL);
+        if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+        return n;
+    }
+
+    int SocketTCP::send(const Span *spans, int count)
+    {
+        if (socket == -1)
+            return IO_ERROR;
+
+        if (count > 64)
+            count = 64;
+
+        #if __WIN32__
+            WSABUF bufs[64];
+            for (int i = 0; i < count; i++) {
+                bufs[i].buf = (CHAR *)spans[i].data;
+                bufs[i].len = spans[i].length;
+            }
+
+            DWORD n;
+            if (::WSASend(socket, bufs, count, &n, 0, nullptr, nullptr) != 0)
+                return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+        #else
+            struct iovec iov[64];
+            for (int i = 0; i < count; i++) {
+                iov[i].iov_base = (void *)spans[i].data;
+                iov[i].iov_len = spans[i].length;
+            }
+
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+
+            int n = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+            if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+        #endif
+
+        return n;
+    }
+
+    int SocketTCP::send(Buffer *const *buffers, int count)
+    {
+        Span spans[64];
+        int num_spans = 0;
+
+        for (int i = 0; i < count && num_spans <= 62; i++)
+            num_spans += buffers[i]->peek(spans + num_spans);
+
+        if (!num_spans)
             return 0;
 
+        int n = send(spans, num_spans);
+        if (n <= 0) return n;
+
+        // Releases exactly what the kernel accepted, which may end in the middle of a buffer.
+        int remaining = n;
+        for (int i = 0; i < count && remaining; i++)
+            remaining -= buffers[i]->drain(remaining < buffers[i]->bytes_available() ? remaining : buffers[i]->bytes_available());
+
+        return n;
+    }
+
+    /**
+     * Sends the data of a file buffer up to a total of `num_bytes` (counting `sent`), optionally refilling it from the
+     * file. Returns `true` if it stopped only because there was no more data, otherwise `status` is set to the error.
+     */
+    static bool send_buffered(SocketTCP *socket, IFileBuffer *file, long num_bytes, long &sent, bool refill, int &status)
+    {
+        while (sent < num_bytes && (file->bytes_available() || (refill && file->refill())))
+        {
+            int length;
+            const char *data = file->peek(length);
+            if (length > num_bytes - sent)
+                length = num_bytes - sent;
+
+            int n = socket->send(data, length);
+            if (n < 0) {
+                status = n;
+                return false;
+            }
+
+            file->drain(n);
+            sent += n;
+
+            if (n < length) {
+                status = IO_WOULD_BLOCK;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    long SocketTCP::send_file(IFileBuffer *file, long num_bytes)
+    {
+        if (socket == -1 || file->get_file() == nullptr)
+            return IO_ERROR;
+
+        if (num_bytes < 0)
+            num_bytes = file->bytes_available() + file->remaining();
+
+        long sent = 0;
+        int status = 0;
+
+        // Data already in the buffer goes first, it precedes the file position.
+        if (!send_buffered(this, file, num_bytes, sent, false, status))
+            return sent ? sent : status;
+
+        #if __linux__
+            FILE *fp = file->get_file();
+            off_t offset = ftell(fp);
+
+            while (sent < num_bytes && file->remaining() > 0)
+            {
+                long length = num_bytes - sent < file->remaining() ? num_bytes - sent : file->remaining();
+                ssize_t n = ::sendfile(socket, fileno(fp), &offset, length > 0x7ffff000 ? 0x7ffff000 : length);
+
+                if (n > 0) {
+                    // The offset is explicit, keep the stream position in sync with it.
+                    fseek(fp, offset, SEEK_SET);
+                    sent += n;
+                    continue;
+                }
+
+                if (n < 0 && would_block())
+                    return sent ? sent : (long)IO_WOULD_BLOCK;
+
+                // Not supported for this file, continue with the buffered path.
+                if (n < 0 && errno != EINVAL && errno != ENOSYS && errno != EOVERFLOW)
+                    return sent ? sent : (long)IO_ERROR;
+
+                break;
+            }
+        #endif
+
+        if (!send_buffered(this, file, num_bytes, sent, true, status))
+            return sent ? sent : status;
+
+        return sent;
+    }
+
+    bool SocketTCP::set_zerocopy(bool value)
+    {
+        #if __linux__
+            int val = value ? 1 : 0;
+            if (::setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) != 0)
+                return false;
+
+            zerocopy = value;
+            return true;
+        #else
+            return !value;
+        #endif
+    }
+
+    int SocketTCP::send_zerocopy(ptr<Buffer> buffer)
+    {
+        if (socket == -1)
+            return IO_ERROR;
+
+        if (!zerocopy || buffer->bytes_available() < zerocopy_threshold)
+            return send(buffer.get());
+
+        #if __linux__
+            Span spans[2];
+            int count = buffer->peek(spans);
+
+            struct iovec iov[2];
+            for (int i = 0; i < count; i++) {
+                iov[i].iov_base = (void *)spans[i].data;
+                iov[i].iov_len = spans[i].length;
+            }
+
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+
+            int n = ::sendmsg(socket, &msg, MSG_NOSIGNAL | MSG_ZEROCOPY);
+            if (n < 0) {
+                // ENOBUFS: the pinned memory limit (optmem_max) was reached, retry after reaping.
+                if (errno == ENOBUFS) return IO_WOULD_BLOCK;
+                return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+            }
+
+            // Every successful call gets the next sequence number, the buffer is released when it completes.
+            zerocopy_sends.push_back({ zerocopy_seq++, buffer });
+            buffer->drain(n);
+            return n;
+        #else
+            return send(buffer.get());
+        #endif
+    }
+
+    int SocketTCP::reap()
+    {
+        int count = 0;
+
+        #if __linux__
+            while (!zerocopy_sends.empty())
+            {
+                char control[128];
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+
+                if (::recvmsg(socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+                    break;
+
+                for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+                {
+                    if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                       || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+                        continue;
+
+                    auto *err = (struct sock_extended_err *)CMSG_DATA(cmsg);
+                    if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                        continue;
+
+                    // Completed range [ee_info, ee_data], in order (with wrap-around of the sequence numbers).
+                    zerocopy_copies = err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+                    while (!zerocopy_sends.empty() && (int32_t)(zerocopy_sends.front().seq - err->ee_data) <= 0) {
+                        zerocopy_sends.pop_front();
+                        count++;
+                    }
+                }
+            }
+        #endif
+
+        return count;
+    }
+
+    int SocketTCP::write(const char *buffer, int num_bytes)
+    {
+        if (socket == -1)
+            return IO_ERROR;
+
         if (num_bytes == -1)
             num_bytes = ::strlen(buffer);
 
-        int n = ::send(socket, buffer, num_bytes, 0);
-        return n < 1 ? 0 : n;
+        if (coalescing)
+            return write_coalesced(buffer, num_bytes);
+
+        // Data can be sent directly only if nothing is queued, otherwise it would be sent out of order.
+        int n = 0;
+        if (!pending())
+        {
+            n = send(buffer, num_bytes);
+            if (n == IO_ERROR) return IO_ERROR;
+            if (n == IO_WOULD_BLOCK) n = 0;
+            if (n == num_bytes) return n;
+        }
+
+        if (output == nullptr)
+            output = new Buffer(queue_size);
+
+        int m = output->fill(buffer + n, num_bytes - n);
+        if (m && reactor)
+            reactor->set_flushing(this, true);
+
+        return n + m ? n + m : IO_WOULD_BLOCK;
+    }
+
+    int SocketTCP::write_coalesced(const char *buffer, int num_bytes)
+    {
+        if (output == nullptr)
+            output = new Buffer(queue_size);
+
+        int n = output->fill(buffer, num_bytes);
+
+        // Past the threshold (or with the queue full) there is enough for full segments, no point in waiting.
+        if (pending() >= coalesce_threshold || n < num_bytes)
+        {
+            if (flush() == IO_ERROR)
+                return IO_ERROR;
+
+            bool blocked = pending() != 0;
+            n += output->fill(buffer + n, num_bytes - n);
+
+            if (pending() && reactor && !blocked)
+                reactor->defer_flush(this);
+        }
+        else if (reactor)
+            reactor->defer_flush(this);
+
+        return n ? n : IO_WOULD_BLOCK;
+    }
+
+    int SocketTCP::flush()
+    {
+        // Both blocks of the queue go out in a single call when it wraps around.
+        while (pending())
+        {
+            int length = pending();
+            int n = send(output.get());
+            if (n == IO_ERROR) return IO_ERROR;
+            if (n == IO_WOULD_BLOCK || n < length) break;
+        }
+
+        // Whatever the socket did not take waits for it to become writeable.
+        int remaining = pending();
+        if (reactor)
+            reactor->set_flushing(this, remaining != 0);
+
+        return remaining;
     }
 
 
     /* *************************************/
     /* SocketUDP */
 
+    #if !__WIN32__
+        /**
+         * Space for the ancillary data of one datagram with the destination address (IPv4 or IPv6) and the receive
+         * timestamps.
+         */
+        static constexpr int CONTROL_SPACE = CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(3 * sizeof(struct timespec));
+
+        /**
+         * Stores the destination address from the ancillary data of a received datagram, with the port the socket is
+         * bound to (kept from the initial copy of the local address).
+         */
+        static void read_pktinfo(struct msghdr *hdr, SockAddr *addr)
+        {
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg))
+            {
+                if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+                    struct in_pktinfo info;
+                    memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+                    ((struct sockaddr_in *)&addr->data)->sin_addr = info.ipi_addr;
+                    return;
+                }
+
+                if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO) {
+                    struct in6_pktinfo info;
+                    memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+                    ((struct sockaddr_in6 *)&addr->data)->sin6_addr = info.ipi6_addr;
+                    return;
+                }
+            }
+        }
+    #endif
+
     SocketUDP::SocketUDP(SOCKET source) : Socket(source) {
         local = nullptr;
         remote = nullptr;
         connected = false;
+        pktinfo = false;
     }
 
     bool SocketUDP::bind(ptr<SockAddr> addr)
@@ -279,15 +907,25 @@ namespace asr {
         if (remote == nullptr)
             remote = this->remote;
 
+        // The length is updated by each call, shorter for unnamed Unix peers.
         num_bytes = num_bytes > buffer_space ? buffer_space : num_bytes;
+        remote->length = sizeof(remote->data);
+
+        #if __linux__
+            if (timestamping) {
+                int n = recv_timestamped(socket, remote.get(), buffer, num_bytes, rx_timestamp);
+                return n < 1 ? 0 : n;
+            }
+        #endif
+
         int n = ::recvfrom(socket, buffer, num_bytes, 0, remote->sockaddr(), &remote->length);
         return n < 1 ? 0 : n;
     }
 
     int SocketUDP::send(ptr<SockAddr> remote, const char *buffer, int num_bytes)
     {
-        if (socket == -1 || !is_writeable(0))
-            return 0;
+        if (socket == -1)
+            return IO_ERROR;
 
         if (num_bytes == -1)
             num_bytes = ::strlen(buffer);
@@ -295,8 +933,633 @@ namespace asr {
         if (remote == nullptr)
             remote = this->remote;
 
-        int n = ::sendto(socket, buffer, num_bytes, 0, remote->sockaddr(), remote->length);
-        return n < 1 ? 0 : n;
+        int n = ::sendto(socket, buffer, num_bytes, MSG_NOSIGNAL, remote->sockaddr(), remote->length);
+        if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+        return n;
+    }
+
+    int SocketUDP::send_segments(ptr<SockAddr> remote, const char *buffer, int num_bytes, int segment_size)
+    {
+        if (socket == -1 || segment_size <= 0)
+            return IO_ERROR;
+
+        if (remote == nullptr)
+            remote = this->remote;
+
+        // Largest run the kernel accepts in a single call (UDP_MAX_SEGMENTS and the maximum UDP payload).
+        int max_run = segment_size;
+        #if __linux__
+            max_run = (65507 / segment_size < 64 ? 65507 / segment_size : 64) * segment_size;
+            if (max_run < segment_size) max_run = segment_size;
+        #endif
+
+        int sent = 0;
+        while (sent < num_bytes)
+        {
+            int length = num_bytes - sent < max_run ? num_bytes - sent : max_run;
+            int n;
+
+            #if __linux__
+            if (length > segment_size)
+            {
+                struct iovec iov = { (void *)(buffer + sent), (size_t)length };
+                char control[CMSG_SPACE(sizeof(uint16_t))];
+                memset(control, 0, sizeof(control));
+
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_name = remote->sockaddr();
+                msg.msg_namelen = remote->length;
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                *(uint16_t *)CMSG_DATA(cmsg) = segment_size;
+
+                n = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+            }
+            else
+            #endif
+                n = ::sendto(socket, buffer + sent, length, MSG_NOSIGNAL, remote->sockaddr(), remote->length);
+
+            if (n < 0) {
+                if (sent) break;
+                return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+            }
+
+            sent += n;
+        }
+
+        return sent;
+    }
+
+    bool SocketUDP::set_gro(bool value)
+    {
+        #if __linux__
+            int val = value ? 1 : 0;
+            return ::setsockopt(socket, SOL_UDP, UDP_GRO, &val, sizeof(val)) == 0;
+        #else
+            return !value;
+        #endif
+    }
+
+    int SocketUDP::recv_segments(ptr<SockAddr> remote, char *buffer, int buffer_space, int &segment_size)
+    {
+        if (socket == -1)
+            return IO_ERROR;
+
+        if (remote == nullptr)
+            remote = this->remote;
+
+        #if __linux__
+            struct iovec iov = { buffer, (size_t)buffer_space };
+            char control[CMSG_SPACE(sizeof(int))];
+
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = remote->sockaddr();
+            msg.msg_namelen = sizeof(remote->data);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            int n = ::recvmsg(socket, &msg, 0);
+            if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+
+            remote->length = msg.msg_namelen;
+            segment_size = n;
+
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                    segment_size = *(int *)CMSG_DATA(cmsg);
+            }
+        #else
+            int n = ::recvfrom(socket, buffer, buffer_space, 0, remote->sockaddr(), &remote->length);
+            if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+            segment_size = n;
+        #endif
+
+        return n;
+    }
+
+    int SocketUDP::recv(DatagramBatch &batch)
+    {
+        if (socket == -1 || local == nullptr)
+            return IO_ERROR;
+
+        batch.clear();
+
+        // Addresses are allocated (once) before the call since the kernel writes straight into them.
+        for (int i = 0; i < batch.num_slots; i++) {
+            if (batch.addresses[i] == nullptr)
+                batch.addresses[i] = local->alloc();
+        }
+
+        #if !__WIN32__
+            if ((pktinfo || timestamping) && batch.control == nullptr)
+                batch.control = (char *)asr::alloc(batch.num_slots * CONTROL_SPACE);
+
+            if (pktinfo && batch.destinations.empty()) {
+                batch.destinations.resize(batch.num_slots);
+                for (int i = 0; i < batch.num_slots; i++) {
+                    batch.destinations[i] = local->alloc();
+                    batch.destinations[i]->set(local.get());
+                }
+            }
+
+            if (timestamping && batch.timestamps.empty())
+                batch.timestamps.resize(batch.num_slots);
+        #endif
+
+        #if __WIN32__
+            for (int i = 0; i < batch.num_slots; i++)
+            {
+                // Only the first call may block.
+                if (i && !is_readable(0))
+                    break;
+
+                SockAddr *addr = batch.addresses[i].get();
+                addr->length = sizeof(addr->data);
+
+                int n = ::recvfrom(socket, batch.data(i), batch.slot_size, 0, addr->sockaddr(), &addr->length);
+                if (n < 0) {
+                    if (i) break;
+                    return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+                }
+
+                batch.lengths[i] = n;
+                batch.count++;
+            }
+        #else
+            for (int i = 0; i < batch.num_slots; i++)
+            {
+                SockAddr *addr = batch.addresses[i].get();
+                batch.iovecs[i].iov_base = batch.data(i);
+                batch.iovecs[i].iov_len = batch.slot_size;
+
+                struct msghdr *hdr = &batch.headers[i].msg_hdr;
+                memset(hdr, 0, sizeof(*hdr));
+                hdr->msg_name = addr->sockaddr();
+                hdr->msg_namelen = sizeof(addr->data);
+                hdr->msg_iov = &batch.iovecs[i];
+                hdr->msg_iovlen = 1;
+
+                if (pktinfo || timestamping) {
+                    hdr->msg_control = batch.control + i * CONTROL_SPACE;
+                    hdr->msg_controllen = CONTROL_SPACE;
+                }
+            }
+
+            // Waits (on blocking sockets) only for the first datagram.
+            int n = ::recvmmsg(socket, batch.headers.data(), batch.num_slots, MSG_WAITFORONE, nullptr);
+            if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+
+            for (int i = 0; i < n; i++) {
+                batch.addresses[i]->length = batch.headers[i].msg_hdr.msg_namelen;
+                batch.lengths[i] = batch.headers[i].msg_len;
+                if (pktinfo) read_pktinfo(&batch.headers[i].msg_hdr, batch.destinations[i].get());
+
+                #if __linux__
+                    if (timestamping) batch.timestamps[i] = read_timestamp(&batch.headers[i].msg_hdr);
+                #endif
+            }
+
+            batch.count = n;
+            batch.has_destinations = pktinfo;
+            batch.has_timestamps = timestamping;
+        #endif
+
+        return batch.count;
+    }
+
+    int SocketUDP::send(DatagramBatch &batch, int offset)
+    {
+        if (socket == -1)
+            return IO_ERROR;
+
+        int count = batch.count - offset;
+        if (count <= 0)
+            return 0;
+
+        #if __WIN32__
+            int sent = 0;
+            for (int i = offset; i < batch.count; i++)
+            {
+                SockAddr *addr = batch.addresses[i].get();
+                if (::sendto(socket, batch.data(i), batch.lengths[i], 0, addr->sockaddr(), addr->length) < 0) {
+                    if (sent) break;
+                    return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+                }
+
+                sent++;
+            }
+
+            return sent;
+        #else
+            for (int i = offset; i < batch.count; i++)
+            {
+                SockAddr *addr = batch.addresses[i].get();
+                batch.iovecs[i].iov_base = batch.data(i);
+                batch.iovecs[i].iov_len = batch.lengths[i];
+
+                struct msghdr *hdr = &batch.headers[i].msg_hdr;
+                memset(hdr, 0, sizeof(*hdr));
+                hdr->msg_name = addr->sockaddr();
+                hdr->msg_namelen = addr->length;
+                hdr->msg_iov = &batch.iovecs[i];
+                hdr->msg_iovlen = 1;
+            }
+
+            int n = ::sendmmsg(socket, &batch.headers[offset], count, MSG_NOSIGNAL);
+            if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+            return n;
+        #endif
+    }
+
+    /**
+     * Joins or leaves a group with the protocol-independent options (MCAST_JOIN_GROUP and friends), which take the
+     * addresses as they are for both IPv4 and IPv6.
+     */
+    static bool group_request(SOCKET socket, int option, int source_option, SockAddr *group, SockAddr *source, int interface)
+    {
+        int level = group->get_family() == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
+
+        if (source == nullptr) {
+            struct group_req req;
+            memset(&req, 0, sizeof(req));
+            req.gr_interface = interface;
+            memcpy(&req.gr_group, &group->data, group->length);
+            return ::setsockopt(socket, level, option, (const char *)&req, sizeof(req)) == 0;
+        }
+
+        struct group_source_req req;
+        memset(&req, 0, sizeof(req));
+        req.gsr_interface = interface;
+        memcpy(&req.gsr_group, &group->data, group->length);
+        memcpy(&req.gsr_source, &source->data, source->length);
+        return ::setsockopt(socket, level, source_option, (const char *)&req, sizeof(req)) == 0;
+    }
+
+    bool SocketUDP::join_group(ptr<SockAddr> group, ptr<SockAddr> source, int interface)
+    {
+        if (socket == -1 && alloc(group->get_family(), SOCK_DGRAM) == -1)
+            return false;
+
+        #if __linux__
+            int val = 0;
+            if (group->get_family() == AF_INET)
+                ::setsockopt(socket, IPPROTO_IP, IP_MULTICAST_ALL, &val, sizeof(val));
+            #ifdef IPV6_MULTICAST_ALL
+            else
+                ::setsockopt(socket, IPPROTO_IPV6, IPV6_MULTICAST_ALL, &val, sizeof(val));
+            #endif
+        #endif
+
+        return group_request(socket, MCAST_JOIN_GROUP, MCAST_JOIN_SOURCE_GROUP, group.get(), source.get(), interface);
+    }
+
+    bool SocketUDP::leave_group(ptr<SockAddr> group, ptr<SockAddr> source, int interface) {
+        if (socket == -1) return false;
+        return group_request(socket, MCAST_LEAVE_GROUP, MCAST_LEAVE_SOURCE_GROUP, group.get(), source.get(), interface);
+    }
+
+    bool SocketUDP::set_multicast_ttl(int ttl)
+    {
+        if (socket == -1 || local == nullptr)
+            return false;
+
+        #if __WIN32__
+            DWORD val = ttl;
+        #else
+            int val = ttl;
+        #endif
+
+        if (local->get_family() == AF_INET6)
+            return ::setsockopt(socket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, (const char *)&val, sizeof(val)) == 0;
+
+        return ::setsockopt(socket, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&val, sizeof(val)) == 0;
+    }
+
+    bool SocketUDP::set_multicast_loop(bool value)
+    {
+        if (socket == -1 || local == nullptr)
+            return false;
+
+        #if __WIN32__
+            DWORD val = value ? 1 : 0;
+        #else
+            int val = value ? 1 : 0;
+        #endif
+
+        if (local->get_family() == AF_INET6)
+            return ::setsockopt(socket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, (const char *)&val, sizeof(val)) == 0;
+
+        return ::setsockopt(socket, IPPROTO_IP, IP_MULTICAST_LOOP, (const char *)&val, sizeof(val)) == 0;
+    }
+
+    bool SocketUDP::set_multicast_interface(int interface)
+    {
+        if (socket == -1 || local == nullptr)
+            return false;
+
+        if (local->get_family() == AF_INET6) {
+            #if __WIN32__
+                DWORD val = interface;
+            #else
+                unsigned int val = interface;
+            #endif
+            return ::setsockopt(socket, IPPROTO_IPV6, IPV6_MULTICAST_IF, (const char *)&val, sizeof(val)) == 0;
+        }
+
+        #if __WIN32__
+            // An address of the form 0.0.0.x selects the interface by index.
+            DWORD val = htonl(interface);
+            return ::setsockopt(socket, IPPROTO_IP, IP_MULTICAST_IF, (const char *)&val, sizeof(val)) == 0;
+        #elif __linux__
+            struct ip_mreqn req;
+            memset(&req, 0, sizeof(req));
+            req.imr_ifindex = interface;
+            return ::setsockopt(socket, IPPROTO_IP, IP_MULTICAST_IF, &req, sizeof(req)) == 0;
+        #else
+            return false;
+        #endif
+    }
+
+    bool SocketUDP::set_pktinfo(bool value)
+    {
+        if (socket == -1 || local == nullptr)
+            return false;
+
+        #if __WIN32__
+            return false;
+        #else
+            int val = value ? 1 : 0;
+            bool ok = local->get_family() == AF_INET6
+                ? ::setsockopt(socket, IPPROTO_IPV6, IPV6_RECVPKTINFO, &val, sizeof(val)) == 0
+                : ::setsockopt(socket, IPPROTO_IP, IP_PKTINFO, &val, sizeof(val)) == 0;
+
+            if (ok) pktinfo = value;
+            return ok;
+        #endif
+    }
+
+    /* *************************************/
+    /* SocketUnix */
+
+    /**
+     * Removes a stale socket file so the path can be bound again: only a socket file that refuses a connection of
+     * the given type (nobody bound to it anymore). Anything else is left, and bind fails with EADDRINUSE. Abstract
+     * names have no file, and on Windows the path is always left since there is no way to tell a socket file apart.
+     */
+    static void unlink_stale(SockAddr *addr, int type)
+    {
+        if (addr->get_family() != AF_UNIX)
+            return;
+
+        SockAddrUnix *unix_addr = (SockAddrUnix *)addr;
+        if (unix_addr->is_abstract() || unix_addr->get_path().empty())
+            return;
+
+        #if !__WIN32__
+            struct stat info;
+            if (::lstat(unix_addr->get_path().c_str(), &info) == -1 || !S_ISSOCK(info.st_mode))
+                return;
+
+            // Non-blocking, a live listener with a full backlog must not stall the bind.
+            SOCKET probe = ::socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (probe == -1) return;
+
+            bool refused = ::connect(probe, addr->sockaddr(), addr->length) == -1 && errno == ECONNREFUSED;
+            ::close(probe);
+
+            if (refused)
+                ::unlink(unix_addr->get_path().c_str());
+        #endif
+    }
+
+    /**
+     * Sends a message with descriptors attached (SCM_RIGHTS), to `remote` if given.
+     */
+    static int send_rights(SOCKET socket, SockAddr *remote, const char *buffer, int num_bytes, const int *fds, int count)
+    {
+        #if __WIN32__
+            return IO_ERROR;
+        #else
+            if (count < 0 || count > MAX_PASSED_FDS)
+                return IO_ERROR;
+
+            char control[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+            struct iovec iov = { (void *)buffer, (size_t)num_bytes };
+
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+
+            if (remote != nullptr) {
+                msg.msg_name = remote->sockaddr();
+                msg.msg_namelen = remote->length;
+            }
+
+            if (count > 0) {
+                memset(control, 0, sizeof(control));
+                msg.msg_control = control;
+                msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+                memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+            }
+
+            int n = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+            if (n < 0) return would_block() ? IO_WOULD_BLOCK : IO_ERROR;
+            return n;
+        #endif
+    }
+
+    /**
+     * Receives a message and the descriptors attached to it, the address of the sender is stored in `remote` if given.
+     */
+    static int recv_rights(SOCKET socket, SockAddr *remote, char *buffer, int num_bytes, int *fds, int &count)
+    {
+        int capacity = count;
+        count = 0;
+
+        #if __WIN32__
+            return 0;
+        #else
+            char control[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+            struct iovec iov = { buffer, (size_t)num_bytes };
+
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (remote != nullptr) {
+                msg.msg_name = remote->sockaddr();
+                msg.msg_namelen = sizeof(remote->data);
+            }
+
+            int n = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+            if (n < 1) return 0;
+
+            if (remote != nullptr)
+                remote->length = msg.msg_namelen;
+
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                    continue;
+
+                int *received = (int *)CMSG_DATA(cmsg);
+                int m = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+                // The ones that do not fit would leak otherwise.
+                for (int i = 0; i < m; i++) {
+                    if (count < capacity)
+                        fds[count++] = received[i];
+                    else
+                        ::close(received[i]);
+                }
+            }
+
+            return n;
+        #endif
+    }
+
+    bool SocketUnix::bind(ptr<SockAddr> addr)
+    {
+        unlink_stale(addr.get(), SOCK_STREAM);
+        return SocketTCP::bind(addr);
+    }
+
+    ptr<SocketUnix> SocketUnix::accept()
+    {
+        if (socket == -1) return nullptr;
+
+        ptr<SockAddr> remote = local->alloc();
+        int nsocket = ::accept(socket, remote->sockaddr(), &remote->length);
+        if (nsocket == -1) return nullptr;
+
+        SocketUnix *client = new SocketUnix(nsocket);
+        client->remote = remote;
+        client->connected = true;
+        return client;
+    }
+
+    int SocketUnix::accept(std::vector<ptr<SocketUnix>> &clients, int max_count)
+    {
+        if (socket == -1) return 0;
+
+        int count = 0;
+        while (count < max_count)
+        {
+            struct sockaddr_storage addr;
+            socklen_t length = sizeof(addr);
+
+            int nsocket = accept_nonblocking(socket, addr, length);
+            if (nsocket == -1) break;
+
+            ptr<SockAddr> remote = local->alloc();
+            std::memcpy(&remote->data, &addr, length);
+            remote->length = length;
+
+            ptr<SocketUnix> client = new SocketUnix(nsocket);
+            client->remote = remote;
+            client->connected = true;
+
+            clients.push_back(client);
+            count++;
+        }
+
+        return count;
+    }
+
+    bool SocketUnix::pair(ptr<SocketUnix> &a, ptr<SocketUnix> &b)
+    {
+        #if __WIN32__
+            return false;
+        #else
+            int fds[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == -1)
+                return false;
+
+            a = new SocketUnix(fds[0]);
+            b = new SocketUnix(fds[1]);
+            a->connected = b->connected = true;
+            a->remote = new SockAddrUnix();
+            b->remote = new SockAddrUnix();
+            return true;
+        #endif
+    }
+
+    int SocketUnix::send_fds(const char *buffer, int num_bytes, const int *fds, int count)
+    {
+        if (socket == -1 || num_bytes < 1)
+            return IO_ERROR;
+
+        // The descriptors must travel with their data, not ahead of what is still queued.
+        if (pending()) {
+            int n = flush();
+            if (n == IO_ERROR) return IO_ERROR;
+            if (n != 0) return IO_WOULD_BLOCK;
+        }
+
+        return send_rights(socket, nullptr, buffer, num_bytes, fds, count);
+    }
+
+    int SocketUnix::recv_fds(char *buffer, int num_bytes, int *fds, int &count)
+    {
+        if (socket == -1) {
+            count = 0;
+            return 0;
+        }
+
+        return recv_rights(socket, nullptr, buffer, num_bytes, fds, count);
+    }
+
+    /* *************************************/
+    /* SocketUnixDgram */
+
+    bool SocketUnixDgram::bind(ptr<SockAddr> addr)
+    {
+        unlink_stale(addr.get(), SOCK_DGRAM);
+        return SocketUDP::bind(addr);
+    }
+
+    int SocketUnixDgram::send_fds(ptr<SockAddr> remote, const char *buffer, int num_bytes, const int *fds, int count)
+    {
+        if (socket == -1)
+            return IO_ERROR;
+
+        if (remote == nullptr)
+            remote = this->remote;
+
+        return send_rights(socket, remote.get(), buffer, num_bytes, fds, count);
+    }
+
+    int SocketUnixDgram::recv_fds(ptr<SockAddr> remote, char *buffer, int num_bytes, int *fds, int &count)
+    {
+        if (socket == -1) {
+            count = 0;
+            return 0;
+        }
+
+        if (remote == nullptr)
+            remote = this->remote;
+
+        return recv_rights(socket, remote.get(), buffer, num_bytes, fds, count);
     }
 
 };
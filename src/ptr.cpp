@@ -1,20 +1,42 @@
-
 #include <asr/ptr>
+#include <mutex>
+#include <cstdint>
 
 namespace asr
 {
-    std::unordered_map<const void*, int> *refs_memory = nullptr;
+    /**
+     * Reference counts are split in shards selected by the address of the pointer, each with its own lock and map,
+     * so threads sharing pointers (i.e. sharded listeners) only contend when their pointers land on the same shard.
+     */
+    struct alignas(64) RefsShard
+    {
+        std::mutex lock;
+        std::unordered_map<const void*, int> *memory = nullptr;
+    };
+
+    static constexpr int REFS_SHARD_BITS = 6;
+    static RefsShard refs_shards[1 << REFS_SHARD_BITS];
+
+    /**
+     * Returns the shard of a pointer, the address is hashed (Fibonacci hashing) since its low bits are always zero.
+     */
+    static inline RefsShard &refs_shard (const void *ptr) {
+        return refs_shards[((uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL) >> (64 - REFS_SHARD_BITS)];
+    }
 
     const void *refs::add (const void *ptr)
     {
-        if (!refs_memory)
-            refs_memory = new std::unordered_map<const void*, int>;
-
         if (!ptr) return ptr;
 
-        auto it = refs_memory->find(ptr);
-        if (it == refs_memory->end())
-            refs_memory->insert({ptr, 1});
+        RefsShard &shard = refs_shard(ptr);
+        std::lock_guard<std::mutex> lock(shard.lock);
+
+        if (!shard.memory)
+            shard.memory = new std::unordered_map<const void*, int>;
+
+        auto it = shard.memory->find(ptr);
+        if (it == shard.memory->end())
+            shard.memory->insert({ptr, 1});
         else
             it->second++;
         return ptr;
@@ -22,24 +44,34 @@ namespace asr
 
     bool refs::remove (const void *ptr)
     {
-        if (!refs_memory || !ptr)
+        if (!ptr) return false;
+
+        RefsShard &shard = refs_shard(ptr);
+        std::lock_guard<std::mutex> lock(shard.lock);
+
+        if (!shard.memory)
             return false;
 
-        auto it = refs_memory->find(ptr);
-        if (it == refs_memory->end() || --it->second > 0)
+        auto it = shard.memory->find(ptr);
+        if (it == shard.memory->end() || --it->second > 0)
             return false;
 
-        refs_memory->erase(it);
+        shard.memory->erase(it);
         return true;
     }
 
     int refs::count (const void *ptr)
     {
-        if (!refs_memory || !ptr)
-            return -1;
+        if (!ptr) return -1;
+
+        RefsShard &shard = refs_shard(ptr);
+        std::lock_guard<std::mutex> lock(shard.lock);
 
-        auto it = refs_memory->find(ptr);
-        if (it == refs_memory->end())
+        if (!shard.memory)
+            return 0;
+
+        auto it = shard.memory->find(ptr);
+        if (it == shard.memory->end())
             return 0;
 
         return it->second;
@@ -47,9 +79,14 @@ namespace asr
 
     void refs::shutdown()
     {
-        if (refs_memory != nullptr) {
-            delete refs_memory;
-            refs_memory = nullptr;
+        for (auto &shard : refs_shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.lock);
+
+            if (shard.memory != nullptr) {
+                delete shard.memory;
+                shard.memory = nullptr;
+            }
         }
     }
 };
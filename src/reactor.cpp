@@ -0,0 +1,458 @@
+
+#include <asr/reactor>
+#include <chrono>
+#include <algorithm>
+
+namespace asr {
+
+    /* *************************************/
+    /* Reactor */
+
+    #if __WIN32__
+
+    Reactor::Reactor(int max_events) : num_entries(0), running(false), next_timer(1), spin_budget(0) {
+    }
+
+    Reactor::~Reactor() {
+    }
+
+    bool Reactor::is_valid() const {
+        return true;
+    }
+
+    Reactor::Entry *Reactor::find(SOCKET socket)
+    {
+        for (int i = 0; i < (int)fds.size(); i++) {
+            if (fds[i].fd == socket)
+                return &entries[i];
+        }
+
+        return nullptr;
+    }
+
+    bool Reactor::update(Entry *entry, bool add)
+    {
+        int events = entry->events;
+        if (entry->flushing) events |= EV_WRITE;
+
+        short flags = 0;
+        if (events & EV_READ) flags |= POLLRDNORM;
+        if (events & EV_WRITE) flags |= POLLWRNORM;
+
+        fds[entry - entries.data()].events = flags;
+        return true;
+    }
+
+    bool Reactor::add(Socket *socket, int events, ReactorHandler *handler, void *data, bool edge)
+    {
+        if (socket->socket == -1 || find(socket->socket))
+            return false;
+
+        socket->set_nonblocking(true);
+
+        WSAPOLLFD pfd = { socket->socket, 0, 0 };
+        fds.push_back(pfd);
+        entries.push_back({ socket, handler, data, events, false, socket->pending() != 0, false });
+        update(&entries.back(), true);
+
+        socket->reactor = this;
+        num_entries++;
+        return true;
+    }
+
+    bool Reactor::remove(Socket *socket)
+    {
+        Entry *entry = find(socket->socket);
+        if (!entry) return false;
+
+        if (entry->deferred)
+            deferred.erase(std::find(deferred.begin(), deferred.end(), socket));
+
+        int i = entry - entries.data();
+        fds.erase(fds.begin() + i);
+        entries.erase(entries.begin() + i);
+
+        socket->reactor = nullptr;
+        num_entries--;
+        return true;
+    }
+
+    int Reactor::collect(int timeout)
+    {
+        ready.clear();
+
+        if (fds.empty()) {
+            if (timeout > 0) ::Sleep(timeout);
+            return 0;
+        }
+
+        int n = ::WSAPoll(fds.data(), fds.size(), timeout);
+        if (n < 0) return -1;
+
+        // Handlers may add or remove sockets, so collect the ready ones first.
+        for (auto& pfd : fds) {
+            if (pfd.revents) ready.push_back(pfd);
+        }
+
+        return ready.size();
+    }
+
+    int Reactor::dispatch(int n)
+    {
+        int count = 0;
+        for (auto& pfd : ready)
+        {
+            Entry *entry = find(pfd.fd);
+            if (!entry) continue;
+            Entry e = *entry;
+
+            int events = 0;
+            if (pfd.revents & POLLRDNORM) events |= EV_READ;
+            if (pfd.revents & POLLWRNORM) events |= EV_WRITE;
+            if (pfd.revents & (POLLERR | POLLNVAL)) events |= EV_ERROR;
+            if (pfd.revents & POLLHUP) events |= EV_HANGUP;
+
+            if ((events & EV_WRITE) && e.flushing) {
+                if (e.socket->flush() == IO_ERROR) events |= EV_ERROR;
+                if (!(e.events & EV_WRITE)) events &= ~EV_WRITE;
+                if (!events) continue;
+            }
+
+            e.handler(e.socket, events, e.data);
+            count++;
+        }
+
+        return count;
+    }
+
+    #else
+
+    Reactor::Reactor(int max_events) : num_entries(0), events(max_events), running(false), next_timer(1), spin_budget(0) {
+        fd = ::epoll_create1(EPOLL_CLOEXEC);
+    }
+
+    Reactor::~Reactor() {
+        if (fd != -1) ::close(fd);
+    }
+
+    bool Reactor::is_valid() const {
+        return fd != -1;
+    }
+
+    Reactor::Entry *Reactor::find(SOCKET socket)
+    {
+        if (socket < 0 || socket >= (int)entries.size() || !entries[socket].socket)
+            return nullptr;
+
+        return &entries[socket];
+    }
+
+    bool Reactor::update(Entry *entry, bool add)
+    {
+        int events = entry->events;
+        if (entry->flushing) events |= EV_WRITE;
+
+        struct epoll_event ev;
+        ev.events = 0;
+        if (events & EV_READ) ev.events |= EPOLLIN | EPOLLRDHUP;
+        if (events & EV_WRITE) ev.events |= EPOLLOUT;
+        if (entry->edge) ev.events |= EPOLLET;
+        ev.data.fd = entry->socket->socket;
+        return ::epoll_ctl(fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, entry->socket->socket, &ev) != -1;
+    }
+
+    bool Reactor::add(Socket *socket, int events, ReactorHandler *handler, void *data, bool edge)
+    {
+        if (fd == -1 || socket->socket == -1 || find(socket->socket))
+            return false;
+
+        socket->set_nonblocking(true);
+
+        if (socket->socket >= (int)entries.size())
+            entries.resize(socket->socket + (socket->socket >> 1) + 64, { nullptr, nullptr, nullptr, 0, false, false, false });
+
+        Entry *entry = &entries[socket->socket];
+        *entry = { socket, handler, data, events, edge, socket->pending() != 0, false };
+
+        if (!update(entry, true)) {
+            entry->socket = nullptr;
+            return false;
+        }
+
+        socket->reactor = this;
+        num_entries++;
+        return true;
+    }
+
+    bool Reactor::remove(Socket *socket)
+    {
+        Entry *entry = find(socket->socket);
+        if (!entry) return false;
+
+        ::epoll_ctl(fd, EPOLL_CTL_DEL, socket->socket, nullptr);
+
+        if (entry->deferred)
+            deferred.erase(std::find(deferred.begin(), deferred.end(), socket));
+
+        *entry = { nullptr, nullptr, nullptr, 0, false, false, false };
+
+        socket->reactor = nullptr;
+        num_entries--;
+        return true;
+    }
+
+    int Reactor::collect(int timeout)
+    {
+        int n = ::epoll_wait(fd, events.data(), events.size(), timeout);
+        if (n < 0) return errno == EINTR ? 0 : -1;
+
+        return n;
+    }
+
+    int Reactor::dispatch(int n)
+    {
+        int count = 0;
+        for (int i = 0; i < n; i++)
+        {
+            // Copied as handlers may register sockets (growing the table) or remove this one.
+            Entry *entry = find(events[i].data.fd);
+            if (!entry) continue;
+            Entry e = *entry;
+
+            uint32_t flags = events[i].events;
+            int ev = 0;
+            if (flags & EPOLLIN) ev |= EV_READ;
+            if (flags & EPOLLOUT) ev |= EV_WRITE;
+            if (flags & EPOLLERR) ev |= EV_ERROR;
+            if (flags & (EPOLLHUP | EPOLLRDHUP)) ev |= EV_HANGUP;
+
+            // Zero-copy completions are reported through the error queue and are not errors.
+            if ((ev & EV_ERROR) && e.socket->reap() > 0 && !e.socket->get_error())
+                ev &= ~EV_ERROR;
+
+            if ((ev & EV_WRITE) && e.flushing) {
+                if (e.socket->flush() == IO_ERROR) ev |= EV_ERROR;
+                if (!(e.events & EV_WRITE)) ev &= ~EV_WRITE;
+            }
+
+            if (!ev) continue;
+
+            e.handler(e.socket, ev, e.data);
+            count++;
+        }
+
+        return count;
+    }
+
+    #endif
+
+    bool Reactor::modify(Socket *socket, int events)
+    {
+        Entry *entry = find(socket->socket);
+        if (!entry) return false;
+
+        int prev = entry->events;
+        entry->events = events;
+
+        if (!update(entry)) {
+            entry->events = prev;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Reactor::set_flushing(Socket *socket, bool value)
+    {
+        Entry *entry = find(socket->socket);
+        if (!entry) return false;
+        if (entry->flushing == value) return true;
+
+        entry->flushing = value;
+        return update(entry);
+    }
+
+    bool Reactor::defer_flush(Socket *socket)
+    {
+        Entry *entry = find(socket->socket);
+        if (!entry) return false;
+
+        if (!entry->deferred) {
+            entry->deferred = true;
+            deferred.push_back(socket);
+        }
+
+        return true;
+    }
+
+    /**
+     * Flushes the sockets deferred during the iteration, a flush that leaves data queued switches the socket to
+     * flushing on writeability.
+     */
+    void Reactor::flush_deferred()
+    {
+        // Handlers called on errors may write to (and defer) other sockets, those are flushed in the same pass.
+        for (size_t i = 0; i < deferred.size(); i++)
+        {
+            Entry *entry = find(deferred[i]->socket);
+            if (!entry) continue;
+
+            entry->deferred = false;
+
+            if (deferred[i]->flush() == IO_ERROR) {
+                Entry e = *entry;
+                e.handler(e.socket, EV_ERROR, e.data);
+            }
+        }
+
+        deferred.clear();
+    }
+
+    /**
+     * Returns the current time of the monotonic clock in milliseconds.
+     */
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    /**
+     * Returns the current time of the monotonic clock in nanoseconds.
+     */
+    static int64_t now_nanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    int Reactor::add_timer(int delay, TimerHandler *handler, void *data)
+    {
+        int id = next_timer++;
+        if (next_timer <= 0) next_timer = 1;
+
+        timers[id] = { handler, data };
+        deadlines.push({ now() + delay, id });
+        return id;
+    }
+
+    bool Reactor::cancel_timer(int id) {
+        return timers.erase(id) != 0;
+    }
+
+    /**
+     * Shortens a wait timeout to the deadline of the next active timer.
+     */
+    int Reactor::next_timeout(int timeout)
+    {
+        while (!deadlines.empty() && !timers.count(deadlines.top().second))
+            deadlines.pop();
+
+        if (deadlines.empty())
+            return timeout;
+
+        int64_t delay = deadlines.top().first - now();
+        if (delay < 0) delay = 0;
+        return timeout < 0 || delay < timeout ? (int)delay : timeout;
+    }
+
+    /**
+     * Calls the handlers of the expired timers, returns how many were run.
+     */
+    int Reactor::run_timers()
+    {
+        int count = 0;
+        int64_t time = now();
+
+        while (!deadlines.empty() && deadlines.top().first <= time)
+        {
+            int id = deadlines.top().second;
+            deadlines.pop();
+
+            auto i = timers.find(id);
+            if (i == timers.end())
+                continue;
+
+            Timer timer = i->second;
+            timers.erase(i);
+
+            timer.handler(id, timer.data);
+            count++;
+        }
+
+        return count;
+    }
+
+    int Reactor::poll(int timeout)
+    {
+        // Writes made outside of the loop must not wait for the next event.
+        if (!deferred.empty())
+            flush_deferred();
+
+        timeout = next_timeout(timeout);
+        counters.polls++;
+
+        int64_t start = now_nanos(), time = start;
+        int n = 0;
+
+        // Checks without blocking until something is ready or the budget (or the timeout) runs out.
+        bool spinning = spin_budget > 0 && timeout != 0;
+        if (spinning)
+        {
+            int64_t limit = start + spin_budget * 1000LL;
+            if (timeout > 0 && start + timeout * 1000000LL < limit)
+                limit = start + timeout * 1000000LL;
+
+            do {
+                n = collect(0);
+                counters.spins++;
+                time = now_nanos();
+            }
+            while (n == 0 && time < limit);
+
+            counters.spin_time += time - start;
+
+            if (n != 0) {
+                if (n > 0) counters.spin_wakeups++;
+                timeout = 0;
+            }
+            else if (timeout > 0) {
+                timeout -= (time - start) / 1000000;
+                if (timeout <= 0) timeout = 0;
+            }
+        }
+
+        if (!spinning || (n == 0 && timeout != 0))
+        {
+            n = collect(timeout);
+            int64_t woken = now_nanos();
+
+            counters.idle_time += woken - time;
+            if (timeout != 0) counters.sleeps++;
+            time = woken;
+        }
+
+        if (n < 0) return -1;
+
+        int count = dispatch(n);
+        count += run_timers();
+
+        if (!deferred.empty())
+            flush_deferred();
+
+        counters.busy_time += now_nanos() - time;
+        return count;
+    }
+
+    void Reactor::run(int timeout)
+    {
+        running = true;
+        while (running) {
+            if (poll(timeout) < 0)
+                break;
+        }
+    }
+
+};
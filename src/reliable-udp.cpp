@@ -0,0 +1,496 @@
+#include <asr/reliable-udp>
+#include <chrono>
+
+namespace asr {
+
+    /* *************************************/
+    /* ReliableChannel */
+
+    /**
+     * Packets: data is the type, the sequence number and the message; an acknowledgement is the type, the next
+     * sequence number expected (everything before it was received), the first one not read yet (the peer may send up
+     * to a window after it) and a bitmap of the ones received after the next expected, up to the end of the window
+     * (trailing zeros are not sent).
+     */
+    static constexpr char PACKET_DATA = (char)0xD5;
+    static constexpr char PACKET_ACK = (char)0xA5;
+    static constexpr int DATA_HEADER = 5;
+    static constexpr int ACK_HEADER = 9;
+    static constexpr int MAX_WINDOW = 8192;
+
+    /**
+     * Returns the current time of the monotonic clock in microseconds.
+     */
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    /**
+     * Returns `true` if sequence number `a` comes before `b`, the numbers wrap around.
+     */
+    static inline bool before(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b) < 0;
+    }
+
+    static inline uint32_t read_seq(const char *data) {
+        return (uint32_t)Buffer::read_uint32be_from((char *)data);
+    }
+
+    ReliableChannel::ReliableChannel(ptr<SocketUDP> socket, ptr<SockAddr> remote, int window, int max_message)
+        : socket(socket), remote(remote), batch(32, max_message + DATA_HEADER), max_message(max_message),
+          send_base(0), send_next(0), probe_at(0), probe_count(0), recv_base(0), recv_next(0), recv_advertised(0),
+          acks_pending(0), broken(false), rttvar(0), rto(100000), min_rto(10), max_rto(2000), max_retries(16)
+    {
+        uint32_t size = 16;
+        while (size < (uint32_t)window && size < (uint32_t)MAX_WINDOW)
+            size <<= 1;
+
+        this->window = size;
+        mask = size - 1;
+        send_limit = size;
+        slot_size = max_message + DATA_HEADER;
+
+        send_block = (char *)asr::alloc(size * slot_size);
+        send_slots.resize(size);
+
+        recv_block = (char *)asr::alloc(size * max_message);
+        recv_lengths.resize(size, -1);
+
+        socket->set_nonblocking(true);
+    }
+
+    ReliableChannel::~ReliableChannel() {
+        asr::dealloc(send_block);
+        asr::dealloc(recv_block);
+    }
+
+    /**
+     * Sends the packet of slot `send_next` with a message of `length` bytes already in place.
+     */
+    void ReliableChannel::commit(int length)
+    {
+        char *data = packet(send_next);
+        data[0] = PACKET_DATA;
+        Buffer::write_uint32be_to(data + 1, send_next);
+
+        SendSlot& slot = send_slots[send_next & mask];
+        slot.length = DATA_HEADER + length;
+        slot.retransmits = 0;
+        slot.acked = false;
+
+        transmit_slot(send_next++, now());
+        counters.sent++;
+    }
+
+    /**
+     * Sends (again) a packet and arms its timer, the timeout doubles with each retransmit.
+     */
+    void ReliableChannel::transmit_slot(uint32_t seq, int64_t now)
+    {
+        SendSlot& slot = send_slots[seq & mask];
+        transmit(packet(seq), slot.length);
+
+        int64_t timeout = rto << (slot.retransmits < 10 ? slot.retransmits : 10);
+        if (timeout > max_rto * 1000L)
+            timeout = max_rto * 1000L;
+
+        slot.nacks = 0;
+        slot.sent_at = now;
+        slot.deadline = now + timeout;
+    }
+
+    int ReliableChannel::send(const char *buffer, int num_bytes)
+    {
+        if (broken || num_bytes <= 0 || num_bytes > max_message)
+            return IO_ERROR;
+
+        if (space_available() <= 0)
+            return IO_WOULD_BLOCK;
+
+        memcpy(packet(send_next) + DATA_HEADER, buffer, num_bytes);
+        commit(num_bytes);
+        return num_bytes;
+    }
+
+    int ReliableChannel::send(Buffer *buffer)
+    {
+        if (broken)
+            return IO_ERROR;
+
+        int total = 0;
+        while (buffer->bytes_available() > 0)
+        {
+            if (space_available() <= 0)
+                return total ? total : IO_WOULD_BLOCK;
+
+            // Drained straight into the slot of the packet.
+            int n = buffer->drain(packet(send_next) + DATA_HEADER, max_message);
+            commit(n);
+            total += n;
+        }
+
+        return total;
+    }
+
+    int ReliableChannel::recv(char *buffer, int num_bytes)
+    {
+        if (recv_base == recv_next)
+            return broken ? IO_ERROR : IO_WOULD_BLOCK;
+
+        int index = recv_base & mask;
+        int length = recv_lengths[index];
+        if (length > num_bytes)
+            return IO_ERROR;
+
+        memcpy(buffer, recv_block + index * max_message, length);
+        recv_lengths[index] = -1;
+        recv_base++;
+
+        consumed();
+        return length;
+    }
+
+    int ReliableChannel::recv(Buffer *buffer)
+    {
+        if (recv_base == recv_next)
+            return broken ? IO_ERROR : IO_WOULD_BLOCK;
+
+        int total = 0;
+        while (recv_base != recv_next)
+        {
+            int index = recv_base & mask;
+            int length = recv_lengths[index];
+            if (length > buffer->space_available())
+                break;
+
+            buffer->fill(recv_block + index * max_message, length);
+            recv_lengths[index] = -1;
+            recv_base++;
+            total += length;
+        }
+
+        consumed();
+        return total;
+    }
+
+    /**
+     * Schedules an acknowledgement once half the window was read since the last one, to let the peer send more.
+     */
+    void ReliableChannel::consumed()
+    {
+        if (recv_base - recv_advertised >= (uint32_t)window / 2)
+            acks_pending++;
+    }
+
+    /**
+     * Stores a message that is inside the window. The window starts at the first message not read yet, the peer does
+     * not send beyond it (messages beyond it are dropped, i.e. from a peer with a larger window).
+     */
+    void ReliableChannel::on_data(uint32_t seq, const char *data, int length)
+    {
+        if (before(seq, recv_base)) {
+            counters.duplicates++;
+            return;
+        }
+
+        if (seq - recv_base >= (uint32_t)window) {
+            counters.dropped++;
+            return;
+        }
+
+        int index = seq & mask;
+        if (recv_lengths[index] >= 0) {
+            counters.duplicates++;
+            return;
+        }
+
+        memcpy(recv_block + index * max_message, data, length);
+        recv_lengths[index] = length;
+        counters.received++;
+
+        while (recv_next - recv_base < (uint32_t)window && recv_lengths[recv_next & mask] >= 0)
+            recv_next++;
+    }
+
+    /**
+     * Updates the smoothed round trip and the retransmit timeout (RFC 6298).
+     */
+    void ReliableChannel::sample_rtt(int64_t rtt)
+    {
+        if (counters.srtt == 0) {
+            counters.srtt = rtt;
+            rttvar = rtt / 2;
+        }
+        else {
+            int64_t delta = counters.srtt > rtt ? counters.srtt - rtt : rtt - counters.srtt;
+            rttvar = (3 * rttvar + delta) / 4;
+            counters.srtt = (7 * counters.srtt + rtt) / 8;
+        }
+
+        rto = counters.srtt + 4 * rttvar;
+        if (rto < min_rto * 1000L) rto = min_rto * 1000L;
+        if (rto > max_rto * 1000L) rto = max_rto * 1000L;
+    }
+
+    /**
+     * Releases the acknowledged messages and retransmits those reported missing by three acknowledgements once the
+     * messages after them arrived.
+     */
+    void ReliableChannel::on_ack(const char *data, int length, int64_t now)
+    {
+        uint32_t ack = read_seq(data + 1);
+        uint32_t base = read_seq(data + 5);
+        const unsigned char *sack = (const unsigned char *)data + ACK_HEADER;
+
+        counters.acks_received++;
+        if (before(send_next, ack) || before(ack, base))
+            return;
+
+        // Acknowledgements may arrive out of order, the room of the peer only grows.
+        if (before(send_limit, base + window)) {
+            send_limit = base + window;
+            probe_at = 0;
+            probe_count = 0;
+        }
+
+        // Only messages sent once give a round trip sample (Karn's algorithm), the newest one is used.
+        int64_t newest = -1;
+        for (; before(send_base, ack); send_base++)
+        {
+            SendSlot& slot = send_slots[send_base & mask];
+            if (!slot.acked && !slot.retransmits && slot.sent_at > newest)
+                newest = slot.sent_at;
+            slot.acked = true;
+        }
+
+        uint32_t highest = ack;
+        for (int i = 0; i < (length - ACK_HEADER) * 8; i++)
+        {
+            uint32_t seq = ack + 1 + i;
+            if (!before(seq, send_next))
+                break;
+
+            // A late acknowledgement may report messages released already, whose slots hold newer ones.
+            if (!((sack[i >> 3] >> (i & 7)) & 1) || before(seq, send_base))
+                continue;
+
+            SendSlot& slot = send_slots[seq & mask];
+            if (!slot.acked && !slot.retransmits && slot.sent_at > newest)
+                newest = slot.sent_at;
+
+            slot.acked = true;
+            highest = seq;
+        }
+
+        if (newest >= 0)
+            sample_rtt(now - newest);
+
+        for (uint32_t seq = send_base; before(seq, highest); seq++)
+        {
+            SendSlot& slot = send_slots[seq & mask];
+            if (slot.acked || slot.nacks < 0)
+                continue;
+
+            // Reordering is tolerated for a quarter of the round trip before the message is taken as lost.
+            if (++slot.nacks < 3 || now - slot.sent_at < counters.srtt + counters.srtt / 4)
+                continue;
+
+            slot.retransmits++;
+            counters.fast_retransmits++;
+            transmit_slot(seq, now);
+
+            // Not again until the timer expires.
+            slot.nacks = -1;
+        }
+    }
+
+    bool ReliableChannel::input(const char *datagram, int length)
+    {
+        if (length >= DATA_HEADER && datagram[0] == PACKET_DATA && length - DATA_HEADER <= max_message) {
+            // Acknowledged even when it is a duplicate, the previous acknowledgement may have been lost.
+            on_data(read_seq(datagram + 1), datagram + DATA_HEADER, length - DATA_HEADER);
+            acks_pending++;
+            return true;
+        }
+
+        if (length >= ACK_HEADER && datagram[0] == PACKET_ACK && length - ACK_HEADER <= window / 8) {
+            on_ack(datagram, length, now());
+            return true;
+        }
+
+        return false;
+    }
+
+    void ReliableChannel::flush()
+    {
+        if (!acks_pending)
+            return;
+
+        char data[ACK_HEADER + MAX_WINDOW / 8];
+        data[0] = PACKET_ACK;
+        Buffer::write_uint32be_to(data + 1, recv_next);
+        Buffer::write_uint32be_to(data + 5, recv_base);
+        recv_advertised = recv_base;
+
+        int length = ACK_HEADER;
+        memset(data + ACK_HEADER, 0, window / 8);
+
+        for (uint32_t seq = recv_next + 1; seq - recv_base < (uint32_t)window; seq++)
+        {
+            if (recv_lengths[seq & mask] < 0)
+                continue;
+
+            int i = seq - recv_next - 1;
+            data[ACK_HEADER + (i >> 3)] |= 1 << (i & 7);
+            length = ACK_HEADER + (i >> 3) + 1;
+        }
+
+        transmit(data, length);
+        counters.acks_sent++;
+        acks_pending = 0;
+    }
+
+    int ReliableChannel::receive()
+    {
+        int total = 0;
+        while (true)
+        {
+            int n = socket->recv(batch);
+            if (n <= 0) break;
+
+            for (int i = 0; i < n; i++) {
+                if (remote->equals(batch.remote(i)))
+                    input(batch.data(i), batch.length(i));
+            }
+
+            total += n;
+            if (n < batch.capacity()) break;
+        }
+
+        flush();
+        return total;
+    }
+
+    int ReliableChannel::update()
+    {
+        flush();
+
+        int64_t t = now();
+        int64_t next = -1;
+
+        for (uint32_t seq = send_base; before(seq, send_next); seq++)
+        {
+            SendSlot& slot = send_slots[seq & mask];
+            if (slot.acked)
+                continue;
+
+            if (slot.deadline <= t)
+            {
+                if (slot.retransmits >= max_retries) {
+                    broken = true;
+                    return -1;
+                }
+
+                slot.retransmits++;
+                counters.retransmits++;
+                transmit_slot(seq, t);
+            }
+
+            if (next < 0 || slot.deadline < next)
+                next = slot.deadline;
+        }
+
+        // Nothing in flight and no room at the peer, the acknowledgement that opens it again may have been lost: the
+        // last message is sent again as a probe, the peer acknowledges duplicates.
+        if (send_base == send_next && send_next == send_limit && send_next != 0)
+        {
+            if (!probe_at)
+                probe_at = t + rto;
+
+            if (probe_at <= t)
+            {
+                uint32_t seq = send_next - 1;
+                transmit(packet(seq), send_slots[seq & mask].length);
+                counters.probes++;
+
+                int64_t timeout = rto << (probe_count < 10 ? ++probe_count : 10);
+                probe_at = t + (timeout < max_rto * 1000L ? timeout : max_rto * 1000L);
+            }
+
+            next = probe_at;
+        }
+
+        return next < 0 ? -1 : (int)((next - t + 999) / 1000);
+    }
+
+    /**
+     * Processes datagrams and timers until the channel is readable (or writeable), sleeping on the socket until the
+     * next retransmit.
+     */
+    bool ReliableChannel::wait(bool readable, int timeout)
+    {
+        int64_t deadline = timeout < 0 ? -1 : now() + timeout * 1000L;
+
+        while (true)
+        {
+            receive();
+            int next = update();
+
+            if (broken) return false;
+            if (readable ? recv_base != recv_next : space_available() > 0)
+                return true;
+
+            int remaining = -1;
+            if (deadline >= 0) {
+                remaining = (int)((deadline - now()) / 1000);
+                if (remaining <= 0) return false;
+            }
+
+            socket->is_readable(next < 0 ? remaining : remaining < 0 || next < remaining ? next : remaining);
+        }
+    }
+
+    /* *************************************/
+    /* IReliableBuffer */
+
+    bool IReliableBuffer::fill_request(int n_min, int n_max, bool inquiry)
+    {
+        int length = channel->next_length();
+        if (inquiry)
+            return length >= n_min && space_available() >= length;
+
+        return refill() >= n_min;
+    }
+
+    /* *************************************/
+    /* OReliableBuffer */
+
+    bool OReliableBuffer::drain_request(int n_min, int n_max, bool inquiry)
+    {
+        if (channel->is_broken())
+            return false;
+
+        if (inquiry)
+            return true;
+
+        // Sends everything it can, waits for acknowledgements only while less than `n_min` bytes were released.
+        int target = bytes_available() - n_min;
+        while (bytes_available() > 0)
+        {
+            int n = channel->send(this);
+            if (n == IO_WOULD_BLOCK) {
+                if (bytes_available() <= target || !channel->wait_writeable())
+                    break;
+                continue;
+            }
+
+            if (n < 0) break;
+        }
+
+        return bytes_available() <= target;
+    }
+
+};
@@ -0,0 +1,43 @@
+
+#include <asr/sharded-listener>
+#include <thread>
+
+namespace asr {
+
+    /* *************************************/
+    /* ShardedListener */
+
+    bool ShardedListener::listen(ptr<SockAddr> addr, int count, int backlog)
+    {
+        close();
+
+        #ifdef SO_REUSEPORT
+            if (count <= 0)
+                count = std::thread::hardware_concurrency();
+            if (count <= 0)
+                count = 1;
+        #else
+            count = 1;
+        #endif
+
+        for (int i = 0; i < count; i++)
+        {
+            ptr<SockAddr> local = addr;
+            if (i != 0) {
+                local = addr->alloc();
+                local->set(shards[0]->local.get());
+            }
+
+            ptr<SocketTCP> shard = new SocketTCP();
+            if (!shard->bind(local, count > 1) || !shard->listen(backlog)) {
+                close();
+                return false;
+            }
+
+            shards.push_back(shard);
+        }
+
+        return true;
+    }
+
+};
@@ -0,0 +1,389 @@
+
+#include <asr/shm-channel>
+
+#if __linux__
+    #include <sys/mman.h>
+    #include <sys/eventfd.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+namespace asr {
+
+    /* *************************************/
+    /* ShmChannel */
+
+    static constexpr uint32_t SHM_MAGIC = 0x41535243;
+
+    /**
+     * Hint to the processor that the thread is spinning.
+     */
+    static inline void cpu_relax()
+    {
+        #if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+        #elif defined(__aarch64__)
+            asm volatile("yield");
+        #endif
+    }
+
+    /**
+     * Maps the region of the memfd, the header is followed by the data of both rings.
+     */
+    bool ShmChannel::map(int capacity)
+    {
+        #if __linux__
+            region_size = sizeof(Header) + 2L * capacity;
+            void *addr = ::mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+            if (addr == MAP_FAILED) {
+                region_size = 0;
+                return false;
+            }
+
+            region = (char *)addr;
+            header = (Header *)addr;
+            mask = capacity - 1;
+
+            output = &header->rings[side];
+            input = &header->rings[side ^ 1];
+            output_data = region + sizeof(Header) + (long)side * capacity;
+            input_data = region + sizeof(Header) + (long)(side ^ 1) * capacity;
+            return true;
+        #else
+            return false;
+        #endif
+    }
+
+    bool ShmChannel::create(int capacity)
+    {
+        close();
+
+        #if __linux__
+            uint32_t size = 4096;
+            while (size < (uint32_t)capacity && size < (1u << 30))
+                size <<= 1;
+
+            side = 0;
+            memfd = ::memfd_create("asr-shm-channel", MFD_CLOEXEC);
+            doorbells[0] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            doorbells[1] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+            if (memfd == -1 || doorbells[0] == -1 || doorbells[1] == -1
+                || ::ftruncate(memfd, sizeof(Header) + 2L * size) == -1 || !map(size)) {
+                close();
+                return false;
+            }
+
+            // The pages are zero-filled, so only the constants need to be set.
+            header->capacity = size;
+            header->magic = SHM_MAGIC;
+            return true;
+        #else
+            return false;
+        #endif
+    }
+
+    bool ShmChannel::attach(const int *fds)
+    {
+        close();
+
+        memfd = fds[0];
+        doorbells[0] = fds[1];
+        doorbells[1] = fds[2];
+        side = 1;
+
+        #if __linux__
+            // Magic and capacity, the first fields of the header.
+            uint32_t info[2];
+            if (::pread(memfd, info, sizeof(info), 0) != sizeof(info) || info[0] != SHM_MAGIC || !map(info[1])) {
+                close();
+                return false;
+            }
+
+            return true;
+        #else
+            close();
+            return false;
+        #endif
+    }
+
+    void ShmChannel::get_fds(int *fds) const {
+        fds[0] = memfd;
+        fds[1] = doorbells[0];
+        fds[2] = doorbells[1];
+    }
+
+    /**
+     * Wakes up a side.
+     */
+    void ShmChannel::ring(int target)
+    {
+        #if __linux__
+            uint64_t value = 1;
+            if (::write(doorbells[target], &value, sizeof(value))) { }
+        #endif
+    }
+
+    void ShmChannel::clear_doorbell()
+    {
+        #if __linux__
+            uint64_t value;
+            if (::read(doorbells[side], &value, sizeof(value))) { }
+        #endif
+    }
+
+    int ShmChannel::bytes_available() const
+    {
+        if (header == nullptr) return 0;
+        return input->head.load(std::memory_order_acquire) - input->tail.load(std::memory_order_relaxed);
+    }
+
+    int ShmChannel::space_available() const
+    {
+        if (header == nullptr) return 0;
+        return header->capacity - (output->head.load(std::memory_order_relaxed) - output->tail.load(std::memory_order_acquire));
+    }
+
+    int ShmChannel::send(const char *buffer, int num_bytes)
+    {
+        if (header == nullptr || is_peer_closed())
+            return IO_ERROR;
+
+        uint32_t head = output->head.load(std::memory_order_relaxed);
+        uint32_t space = header->capacity - (head - output->tail.load(std::memory_order_acquire));
+
+        int n = (uint32_t)num_bytes < space ? num_bytes : space;
+        if (n <= 0)
+            return num_bytes > 0 ? IO_WOULD_BLOCK : 0;
+
+        uint32_t offset = head & mask;
+        uint32_t first = header->capacity - offset;
+        if ((uint32_t)n <= first)
+            memcpy(output_data + offset, buffer, n);
+        else {
+            memcpy(output_data + offset, buffer, first);
+            memcpy(output_data, buffer + first, n - first);
+        }
+
+        output->head.store(head + n, std::memory_order_release);
+
+        // Pairs with the fence of the reader between raising its flag and checking the ring again.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (output->reader_waiting.load(std::memory_order_relaxed) && output->reader_waiting.exchange(0))
+            ring(side ^ 1);
+
+        return n;
+    }
+
+    int ShmChannel::send(Buffer *buffer)
+    {
+        Span spans[2];
+        int count = buffer->peek(spans);
+        int total = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            int n = send(spans[i].data, spans[i].length);
+            if (n < 0) {
+                if (total) break;
+                return n;
+            }
+
+            total += n;
+            if (n < spans[i].length)
+                break;
+        }
+
+        buffer->drain(total);
+        return total;
+    }
+
+    int ShmChannel::recv(char *buffer, int num_bytes)
+    {
+        if (header == nullptr)
+            return 0;
+
+        uint32_t tail = input->tail.load(std::memory_order_relaxed);
+        uint32_t available = input->head.load(std::memory_order_acquire) - tail;
+
+        if (!available)
+            return is_peer_closed() && !bytes_available() ? 0 : IO_WOULD_BLOCK;
+
+        int n = (uint32_t)num_bytes < available ? num_bytes : available;
+
+        uint32_t offset = tail & mask;
+        uint32_t first = header->capacity - offset;
+        if ((uint32_t)n <= first)
+            memcpy(buffer, input_data + offset, n);
+        else {
+            memcpy(buffer, input_data + offset, first);
+            memcpy(buffer + first, input_data, n - first);
+        }
+
+        input->tail.store(tail + n, std::memory_order_release);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (input->writer_waiting.load(std::memory_order_relaxed) && input->writer_waiting.exchange(0))
+            ring(side ^ 1);
+
+        return n;
+    }
+
+    int ShmChannel::recv(Buffer *buffer)
+    {
+        if (header == nullptr)
+            return 0;
+
+        uint32_t tail = input->tail.load(std::memory_order_relaxed);
+        uint32_t available = input->head.load(std::memory_order_acquire) - tail;
+
+        if (!available)
+            return is_peer_closed() && !bytes_available() ? 0 : IO_WOULD_BLOCK;
+
+        // Copied straight from the ring into the buffer, in two parts when the data wraps around.
+        uint32_t n = buffer->space_available();
+        n = n < available ? n : available;
+
+        uint32_t offset = tail & mask;
+        uint32_t first = header->capacity - offset;
+        int total = buffer->fill(input_data + offset, n <= first ? n : first);
+        if (n > first)
+            total += buffer->fill(input_data, n - first);
+
+        input->tail.store(tail + total, std::memory_order_release);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (input->writer_waiting.load(std::memory_order_relaxed) && input->writer_waiting.exchange(0))
+            ring(side ^ 1);
+
+        return total;
+    }
+
+    bool ShmChannel::arm()
+    {
+        if (header == nullptr)
+            return false;
+
+        input->reader_waiting.store(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (bytes_available() || is_peer_closed()) {
+            input->reader_waiting.store(0);
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Spins and then sleeps on the doorbell until the ring is readable (or writeable), raising the flag that makes the
+     * other side ring it. The flag is checked again after raising it, so a write in between is not missed.
+     */
+    bool ShmChannel::wait(bool readable, int timeout)
+    {
+        if (header == nullptr)
+            return false;
+
+        auto ready = [&]() {
+            return is_peer_closed() || (readable ? bytes_available() > 0 : space_available() > 0);
+        };
+
+        for (int i = 0; i < spin_count; i++) {
+            if (ready()) return true;
+            cpu_relax();
+        }
+
+        #if __linux__
+            std::atomic<uint32_t> &flag = readable ? input->reader_waiting : output->writer_waiting;
+
+            while (true)
+            {
+                flag.store(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                if (ready()) {
+                    flag.store(0);
+                    return true;
+                }
+
+                struct pollfd pfd = { doorbells[side], POLLIN, 0 };
+                int n = ::poll(&pfd, 1, timeout);
+                clear_doorbell();
+
+                if (n == 0) {
+                    flag.store(0);
+                    return ready();
+                }
+
+                if (ready())
+                    return true;
+            }
+        #else
+            return false;
+        #endif
+    }
+
+    void ShmChannel::close()
+    {
+        #if __linux__
+            if (header != nullptr) {
+                header->closed[side].store(1, std::memory_order_release);
+                ring(side ^ 1);
+                ::munmap(region, region_size);
+            }
+
+            if (memfd != -1) ::close(memfd);
+            if (doorbells[0] != -1) ::close(doorbells[0]);
+            if (doorbells[1] != -1) ::close(doorbells[1]);
+        #endif
+
+        header = nullptr;
+        region = nullptr;
+        region_size = 0;
+        memfd = doorbells[0] = doorbells[1] = -1;
+        input = output = nullptr;
+        input_data = output_data = nullptr;
+    }
+
+    /* *************************************/
+    /* IShmBuffer */
+
+    bool IShmBuffer::fill_request(int n_min, int n_max, bool inquiry)
+    {
+        int available = channel->bytes_available();
+        if (inquiry)
+            return available >= n_min && space_available() >= n_min;
+
+        int n = channel->recv(this);
+        return n >= n_min;
+    }
+
+    /* *************************************/
+    /* OShmBuffer */
+
+    bool OShmBuffer::drain_request(int n_min, int n_max, bool inquiry)
+    {
+        if (!channel->is_open() || channel->is_peer_closed())
+            return false;
+
+        if (inquiry)
+            return true;
+
+        // Writes everything it can, waits for the reader only while less than `n_min` bytes were released.
+        int target = bytes_available() - n_min;
+        while (bytes_available() > 0)
+        {
+            int n = channel->send(this);
+            if (n == IO_WOULD_BLOCK) {
+                if (bytes_available() <= target || !channel->wait_writeable())
+                    break;
+                continue;
+            }
+
+            if (n < 0) break;
+        }
+
+        return bytes_available() <= target;
+    }
+
+};
@@ -0,0 +1,36 @@
+
+#include <asr/socket-pool>
+
+namespace asr {
+
+    /* *************************************/
+    /* SocketPool */
+
+    ptr<SocketTCP> SocketPool::get(SOCKET source)
+    {
+        int n = sockets.size();
+
+        // Round-robin over the objects, long lived connections are skipped after a few probes.
+        for (int i = 0; i < probe_count && i < n; i++)
+        {
+            if (++cursor >= n) cursor = 0;
+
+            ptr<SocketTCP>& socket = sockets[cursor];
+            if (socket.count() == 1) {
+                socket->reset(source);
+                recycled++;
+                return socket;
+            }
+        }
+
+        ptr<SocketTCP> socket = new SocketTCP(source);
+        socket->connected = true;
+        created++;
+
+        if (n < max_size)
+            sockets.push_back(socket);
+
+        return socket;
+    }
+
+};
@@ -0,0 +1,124 @@
+
+#include <asr/splicer>
+
+#if __linux__
+    #include <fcntl.h>
+#endif
+
+namespace asr {
+
+    /**
+     * Returns `true` if the last socket operation failed only because it would have blocked.
+     */
+    static bool would_block()
+    {
+        #if __WIN32__
+            return WSAGetLastError() == WSAEWOULDBLOCK;
+        #else
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        #endif
+    }
+
+    /* *************************************/
+    /* Splicer */
+
+    Splicer::Splicer(int capacity) : capacity(capacity), buffered(0), eof(false)
+    {
+        fds[0] = fds[1] = -1;
+
+        #if __linux__
+            if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0) {
+                int size = ::fcntl(fds[1], F_SETPIPE_SZ, capacity);
+                if (size > 0) this->capacity = size;
+                return;
+            }
+
+            fds[0] = fds[1] = -1;
+        #endif
+
+        staging = new Buffer(capacity);
+    }
+
+    Splicer::~Splicer()
+    {
+        if (fds[0] != -1) {
+            ::close(fds[0]);
+            ::close(fds[1]);
+        }
+    }
+
+    int Splicer::transfer(SocketTCP *source, SocketTCP *target, int max_bytes)
+    {
+        if (source->socket == -1 || target->socket == -1)
+            return IO_ERROR;
+
+        int written = 0;
+
+        while (written < max_bytes)
+        {
+            bool progress = false;
+
+            // Fill the pipe (or staging buffer) from the source.
+            if (!eof && pending() < capacity)
+            {
+                int n;
+                #if __linux__
+                if (staging == nullptr)
+                {
+                    n = ::splice(source->socket, nullptr, fds[1], nullptr, capacity - buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                    if (n > 0) buffered += n;
+                }
+                else
+                #endif
+                {
+                    char temp[16384];
+                    int space = staging->space_available();
+                    n = ::recv(source->socket, temp, space < (int)sizeof(temp) ? space : sizeof(temp), 0);
+                    if (n > 0) staging->fill(temp, n);
+                }
+
+                if (n > 0)
+                    progress = true;
+                else if (n == 0)
+                    eof = true;
+                else if (!would_block())
+                    return written ? written : IO_ERROR;
+            }
+
+            // Drain it into the target.
+            if (pending())
+            {
+                int n;
+                #if __linux__
+                if (staging == nullptr)
+                {
+                    int length = pending() < max_bytes - written ? pending() : max_bytes - written;
+                    n = ::splice(fds[0], nullptr, target->socket, nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                    if (n > 0) buffered -= n;
+                    else if (n < 0 && would_block()) n = IO_WOULD_BLOCK;
+                    else if (n < 0) n = IO_ERROR;
+                }
+                else
+                #endif
+                    n = target->send(staging.get());
+
+                if (n == IO_ERROR)
+                    return written ? written : IO_ERROR;
+
+                if (n > 0) {
+                    written += n;
+                    progress = true;
+                }
+            }
+
+            if (!progress)
+                break;
+        }
+
+        if (written)
+            return written;
+
+        return eof && !pending() ? 0 : IO_WOULD_BLOCK;
+    }
+
+};
@@ -1,10 +1,12 @@
-
 #include <asr/defs>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <set>
+#include <cstring>
 
 using namespace asr;
 using namespace std;
@@ -13,6 +15,28 @@ set<string> base_types = {
     "int", "uint"
 };
 
+/**
+ * Describes a primitive wire type and the runtime helpers used to load/store it.
+ */
+struct WireType {
+    int size;
+    string loader;
+    string storer;
+};
+
+unordered_map<string, WireType> wire_types = {
+    { "uint8",    { 1, "ld_u8",    "st_8"    } },
+    { "int8",     { 1, "ld_i8",    "st_8"    } },
+    { "uint16",   { 2, "ld_u16",   "st_16"   } },
+    { "int16",    { 2, "ld_i16",   "st_16"   } },
+    { "uint16be", { 2, "ld_u16be", "st_16be" } },
+    { "int16be",  { 2, "ld_i16be", "st_16be" } },
+    { "uint32",   { 4, "ld_u32",   "st_32"   } },
+    { "int32",    { 4, "ld_i32",   "st_32"   } },
+    { "uint32be", { 4, "ld_u32be", "st_32be" } },
+    { "int32be",  { 4, "ld_i32be", "st_32be" } },
+};
+
 int get_indentation (const string& line) {
     int size = 0;
     for (char c : line) {
@@ -48,149 +72,1250 @@ string get_word (string& line) {
     return rtrim(value);
 }
 
-bool expect_word (string& line, const string& expected) {
+/**
+ * Number of errors found while compiling the schema.
+ */
+int num_errors = 0;
+
+ostream& error (int line_number) {
+    num_errors++;
+    return cout << "\e[91merror:\e[0m line " << line_number << ": ";
+}
+
+ostream& warning (int line_number) {
+    return cout << "\e[93mwarning:\e[0m line " << line_number << ": ";
+}
+
+bool expect_word (string& line, const string& expected, int line_number) {
     string word = get_word(line);
     if (word != expected) {
-        cout << "\e[91merror:\e[0m expected: \e[97m" << expected << "\e[0m found: \e[97m" << word << "\e[0m\n";
+        error(line_number) << "expected: \e[97m" << expected << "\e[0m found: \e[97m" << word << "\e[0m\n";
         return false;
     }
     return true;
 }
 
+/**
+ * Returns the string as a C++ string literal.
+ */
+string quote (const string& value)
+{
+    string result = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+/**
+ * Line of the schema file with its indented children.
+ */
+struct Line {
+    int number;
+    int indent_level;
+    string text;
+    vector<Line> children;
+};
+
+/**
+ * Statement of a type or record body.
+ */
+struct Stmt {
+    enum Kind { S_PEEK, S_LOAD, S_SKIP, S_IF, S_RET, S_CHECK, S_STORE };
+
+    Kind kind;
+    int line_number;
+
+    string type;        // Wire or custom type (S_PEEK, S_LOAD, S_STORE).
+    string target;      // Target variable (S_PEEK, S_LOAD, S_CHECK).
+    string expr;        // Expression (S_IF, S_RET, S_STORE).
+    int num_bytes = 0;  // Number of bytes (S_SKIP).
+
+    vector<string> values;  // Accepted values (S_CHECK).
+    string errorcode = "0";
+    string errormsg = "invalid field value found";
+
+    vector<Stmt> body;  // Conditional statements (S_IF).
+};
+
+/**
+ * Variable (local or field) of a type or record.
+ */
+struct Var {
+    string name;
+    string type;
+};
+
 struct Type {
     string name;
     string base_type;
-    unordered_map<string, Type> locals;
-    string code;
-    int indent_level;
+    bool is_record = false;
+    int line_number = 0;
+
+    vector<Var> vars;
+    vector<Stmt> decode;
+
+    bool has_encode = false;
+    string encode_var;
+    vector<Stmt> encode;
 
     Type()
     { }
 
-    Type(const string& name, const string& base_type, int indent_level) 
-        : name(name), base_type(base_type), indent_level(indent_level)
+    Type(const string& name, const string& base_type, int line_number)
+        : name(name), base_type(base_type), line_number(line_number)
     { }
+
+    const Var *find_var (const string& name) const {
+        for (auto& var : vars)
+            if (var.name == name) return &var;
+        return nullptr;
+    }
 };
 
+unordered_map<string, Type> types;
+vector<string> type_order;
+
 /**
+ * Command line options.
  */
-int _main (int argc, const char *argv[])
+struct Options {
+    bool batch = false;     // Emit `decode_batch` for each record.
+    string bench_path;      // Output file of the generated benchmark (empty for none).
+};
+
+Options options;
+
+/**
+ * Returns the C++ type for a base type.
+ */
+string cpp_type (const string& base_type) {
+    return base_type == "uint" ? "unsigned int" : "int";
+}
+
+/**
+ * Builds the indentation tree of the schema file.
+ */
+vector<Line> parse_lines (istream& input)
 {
-    ifstream schema(argv[1]);
-    if (!schema) {
-        cout << "\e[91merror:\e[0m failed to open schema file: \e[97m" << argv[1] << "\e[0m\n";
-        return 1;
+    vector<Line> root;
+    vector<pair<int, vector<Line>*>> stack = { { -1, &root } };
+
+    string line;
+    int line_number = 0;
+
+    while (getline(input, line))
+    {
+        line_number++;
+        int indent_level = get_indentation(line);
+
+        line = rtrim(line.substr(indent_level));
+        if (line.empty() || is_comment(line))
+            continue;
+
+        while (stack.back().first >= indent_level)
+            stack.pop_back();
+
+        auto list = stack.back().second;
+        list->push_back({ line_number, indent_level, line, {} });
+        stack.push_back({ indent_level, &list->back().children });
     }
 
-    ofstream output(argv[2]);
-    if (!output) {
-        cout << "\e[91merror:\e[0m failed to open output file: \e[97m" << argv[2] << "\e[0m\n";
-        return 1;
+    return root;
+}
+
+/**
+ * Returns `true` if the name is a type that can be loaded/stored.
+ */
+bool is_loadable (const string& name) {
+    if (wire_types.find(name) != wire_types.end())
+        return true;
+    auto it = types.find(name);
+    return it != types.end() && !it->second.is_record;
+}
+
+/**
+ * Parses the statements of a type or record body.
+ */
+vector<Stmt> parse_stmts (const vector<Line>& lines, Type& scope, bool encode_mode)
+{
+    vector<Stmt> stmts;
+
+    for (auto& l : lines)
+    {
+        string line = l.text;
+        string cmd = get_word(line);
+
+        if (cmd == "local" || cmd == "field" || cmd == "encode") {
+            error(l.number) << "\e[97m" << cmd << "\e[0m not allowed here\n";
+            continue;
+        }
+
+        Stmt stmt;
+        stmt.line_number = l.number;
+
+        // peek <type> into <var>
+        // load <type> into <var>
+        if ((cmd == "peek" || cmd == "load") && !encode_mode)
+        {
+            stmt.kind = cmd == "peek" ? Stmt::S_PEEK : Stmt::S_LOAD;
+            stmt.type = get_word(line);
+            if (!is_loadable(stmt.type)) {
+                error(l.number) << "invalid type: \e[97m" << stmt.type << "\e[0m\n";
+                continue;
+            }
+
+            if (!expect_word(line, "into", l.number))
+                continue;
+
+            stmt.target = get_word(line);
+            if (!scope.find_var(stmt.target)) {
+                error(l.number) << "undefined variable: \e[97m" << stmt.target << "\e[0m\n";
+                continue;
+            }
+        }
+        // store <wire-type> <expr>
+        else if (cmd == "store" && encode_mode)
+        {
+            stmt.kind = Stmt::S_STORE;
+            stmt.type = get_word(line);
+            if (wire_types.find(stmt.type) == wire_types.end()) {
+                error(l.number) << "invalid wire type: \e[97m" << stmt.type << "\e[0m\n";
+                continue;
+            }
+
+            stmt.expr = ltrim(line);
+            if (stmt.expr.empty()) {
+                error(l.number) << "expected expression\n";
+                continue;
+            }
+        }
+        // skip <num_bytes>
+        else if (cmd == "skip")
+        {
+            stmt.kind = Stmt::S_SKIP;
+            stmt.num_bytes = atoi(get_word(line).c_str());
+            if (stmt.num_bytes <= 0) {
+                error(l.number) << "invalid number of bytes to skip\n";
+                continue;
+            }
+        }
+        // if <expr>
+        else if (cmd == "if")
+        {
+            stmt.kind = Stmt::S_IF;
+            stmt.expr = ltrim(line);
+            if (stmt.expr.empty()) {
+                error(l.number) << "expected expression\n";
+                continue;
+            }
+            stmt.body = parse_stmts(l.children, scope, encode_mode);
+            stmts.push_back(stmt);
+            continue;
+        }
+        // ret [<expr>]
+        else if (cmd == "ret")
+        {
+            if (scope.is_record) {
+                error(l.number) << "\e[97mret\e[0m is only allowed in types\n";
+                continue;
+            }
+
+            stmt.kind = Stmt::S_RET;
+            stmt.expr = ltrim(line);
+            if (stmt.expr.empty() && !encode_mode) {
+                error(l.number) << "expected expression\n";
+                continue;
+            }
+        }
+        // check value[s] of <var> [throws <code> [<message>]]
+        else if (cmd == "check")
+        {
+            stmt.kind = Stmt::S_CHECK;
+
+            string word = get_word(line);
+            if (word != "value" && word != "values") {
+                error(l.number) << "expected: \e[97mvalues\e[0m found: \e[97m" << word << "\e[0m\n";
+                continue;
+            }
+
+            if (!expect_word(line, "of", l.number))
+                continue;
+
+            stmt.target = get_word(line);
+            if (!scope.find_var(stmt.target) && stmt.target != scope.encode_var) {
+                error(l.number) << "undefined variable: \e[97m" << stmt.target << "\e[0m\n";
+                continue;
+            }
+
+            if (get_word(line) == "throws") {
+                stmt.errorcode = get_word(line);
+                line = ltrim(line);
+                if (!line.empty())
+                    stmt.errormsg = line;
+            }
+
+            for (auto& child : l.children) {
+                string values = child.text;
+                for (string value = get_word(values); !value.empty(); value = get_word(values))
+                    stmt.values.push_back(value);
+            }
+
+            if (stmt.values.empty()) {
+                error(l.number) << "no values to check\n";
+                continue;
+            }
+
+            stmts.push_back(stmt);
+            continue;
+        }
+        else {
+            error(l.number) << "invalid keyword: \e[97m" << cmd << "\e[0m\n";
+            continue;
+        }
+
+        if (!l.children.empty())
+            error(l.children[0].number) << "unexpected indentation\n";
+
+        stmts.push_back(stmt);
     }
 
-    unordered_map<string, Type> types;
-    Type active_type;
+    return stmts;
+}
 
-    string line, cmd;
-    int state = 0, target_indent_level = -1;
+/**
+ * Parses a `type` or `record` definition.
+ */
+void parse_type (const Line& l)
+{
+    string line = l.text;
+    string cmd = get_word(line);
+    string name = get_word(line);
 
-    while (getline(schema, line))
+    if (name.empty()) {
+        error(l.number) << "expected name\n";
+        return;
+    }
+
+    if (types.find(name) != types.end() || wire_types.find(name) != wire_types.end()) {
+        error(l.number) << "duplicate type: \e[97m" << name << "\e[0m\n";
+        return;
+    }
+
+    Type type;
+
+    // type <type_name> as <base_type>
+    if (cmd == "type")
     {
-        int indent_level = get_indentation(line);
+        if (!expect_word(line, "as", l.number))
+            return;
 
-        line = rtrim(line.substr(indent_level));
-        if (is_comment(line) || line.empty())
+        string base_type = get_word(line);
+        if (base_types.find(base_type) == base_types.end()) {
+            error(l.number) << "invalid base type: \e[97m" << base_type << "\e[0m\n";
+            return;
+        }
+
+        type = Type(name, base_type, l.number);
+    }
+    // record <record_name>
+    else if (cmd == "record")
+    {
+        type = Type(name, "", l.number);
+        type.is_record = true;
+    }
+    else {
+        error(l.number) << "invalid keyword: \e[97m" << cmd << "\e[0m\n";
+        return;
+    }
+
+    const char *var_keyword = type.is_record ? "field" : "local";
+    vector<Line> body;
+
+    for (auto& child : l.children)
+    {
+        string line = child.text;
+        string cmd = get_word(line);
+
+        // local <name> as <base_type>
+        // field <name> as <base_type|type>
+        if (cmd == var_keyword)
+        {
+            string name = get_word(line);
+            if (type.find_var(name)) {
+                error(child.number) << type.name << ": duplicate " << cmd << " variable: \e[97m" << name << "\e[0m\n";
+                continue;
+            }
+
+            if (!expect_word(line, "as", child.number))
+                continue;
+
+            string var_type = get_word(line);
+            if (type.is_record && types.find(var_type) != types.end() && !types[var_type].is_record)
+                var_type = types[var_type].base_type;
+
+            if (base_types.find(var_type) == base_types.end()) {
+                error(child.number) << type.name << ": invalid base type: \e[97m" << var_type << "\e[0m\n";
+                continue;
+            }
+
+            type.vars.push_back({ name, var_type });
             continue;
+        }
 
-        if (target_indent_level != -1) {
-            if (indent_level != target_indent_level)
+        // encode <var>
+        if (cmd == "encode" && !type.is_record)
+        {
+            if (type.has_encode) {
+                error(child.number) << type.name << ": duplicate encode block\n";
                 continue;
-            target_indent_level = -1;
+            }
+
+            type.has_encode = true;
+            type.encode_var = get_word(line);
+            if (type.encode_var.empty()) {
+                error(child.number) << "expected variable name\n";
+                continue;
+            }
+
+            type.encode = parse_stmts(child.children, type, true);
+            continue;
         }
 
-        cmd = get_word(line);
-        cout << ":::" << cmd << endl;
+        body.push_back(child);
+    }
+
+    type.decode = parse_stmts(body, type, false);
 
-        switch (state)
+    types[name] = type;
+    type_order.push_back(name);
+}
+
+
+/**
+ * Returns the number of bytes of a statement list if the size does not depend on the data, or -1 otherwise. The
+ * number of bytes that must be available (including trailing peeks) is stored in `required`.
+ */
+int fixed_size (const vector<Stmt>& stmts, int *required)
+{
+    int offset = 0;
+    *required = 0;
+
+    for (auto& stmt : stmts)
+    {
+        switch (stmt.kind)
         {
-            case 0: // type, record
-
-                // type <type_name> as <base_type>
-                if (cmd == "type")
-                {
-                    string name = get_word(line);
-                    if (types.find(name) != types.end()) {
-                        cout << "\e[91merror:\e[0m duplicate type: \e[97m" << name << "\e[0m\n";
-                        target_indent_level = indent_level;
-                        break;
-                    }
+            case Stmt::S_PEEK:
+            case Stmt::S_LOAD:
+                if (wire_types.find(stmt.type) == wire_types.end())
+                    return -1;
+                *required = max(*required, offset + wire_types[stmt.type].size);
+                if (stmt.kind == Stmt::S_LOAD)
+                    offset += wire_types[stmt.type].size;
+                break;
 
-                    if (!expect_word(line, "as")) {
-                        target_indent_level = indent_level;
-                        break;
-                    }
+            case Stmt::S_SKIP:
+                offset += stmt.num_bytes;
+                *required = max(*required, offset);
+                break;
+
+            case Stmt::S_CHECK:
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    return offset;
+}
+
+/**
+ * Returns an upper bound of the number of bytes used by a statement list.
+ */
+int max_size (const vector<Stmt>& stmts, bool encode)
+{
+    int size = 0;
+
+    for (auto& stmt : stmts)
+    {
+        switch (stmt.kind)
+        {
+            case Stmt::S_PEEK:
+                if (encode) break;
+                [[fallthrough]];
+            case Stmt::S_LOAD:
+            case Stmt::S_STORE:
+                if (wire_types.find(stmt.type) != wire_types.end())
+                    size += wire_types[stmt.type].size;
+                else if (encode)
+                    size += max_size(types[stmt.type].encode, true);
+                else
+                    size += max_size(types[stmt.type].decode, false);
+                break;
+
+            case Stmt::S_SKIP:
+                size += stmt.num_bytes;
+                break;
+
+            case Stmt::S_IF:
+                size += max_size(stmt.body, encode);
+                break;
+        }
+    }
+
+    return size;
+}
+
+/**
+ * Returns `true` if all custom types loaded by the statements can be encoded.
+ */
+bool can_encode (const vector<Stmt>& stmts)
+{
+    for (auto& stmt : stmts)
+    {
+        if (stmt.kind == Stmt::S_IF && !can_encode(stmt.body))
+            return false;
+
+        if (stmt.kind == Stmt::S_LOAD && wire_types.find(stmt.type) == wire_types.end() && !types[stmt.type].has_encode) {
+            warning(stmt.line_number) << "type \e[97m" << stmt.type << "\e[0m has no encode block, encoder not generated\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Code emission context.
+ */
+struct Emitter
+{
+    ostream& out;
+
+    /**
+     * When `true` all offsets are constant relative to `_data` and no bounds checks are emitted.
+     */
+    bool fixed = false;
+    int offset = 0;
 
-                    string type = get_word(line);
-                    if (base_types.find(type) == base_types.end()) {
-                        cout << "\e[91merror:\e[0m invalid base type: \e[97m" << type << "\e[0m\n";
-                        target_indent_level = indent_level;
-                        break;
+    /**
+     * Statement emitted when there is not enough data (or space) to continue.
+     */
+    string fail = "";
+
+    /**
+     * Prefix of the variables (i.e. `r.` when decoding into a record reference).
+     */
+    string self = "";
+
+    /**
+     * When set, checks are collected as branch-free conditions instead of emitting a `switch`.
+     */
+    vector<string> *conds = nullptr;
+
+    string pad (int level) const {
+        return string(level * 4, ' ');
+    }
+
+    string at() const {
+        if (!fixed) return "_p";
+        return offset ? "_data + " + to_string(offset) : "_data";
+    }
+
+    void require (int level, int num_bytes) {
+        if (!fixed)
+            out << pad(level) << "if (_end - _p < " << num_bytes << ") " << fail << "\n";
+    }
+
+    void advance (int level, int num_bytes) {
+        if (fixed)
+            offset += num_bytes;
+        else
+            out << pad(level) << "_p += " << num_bytes << ";\n";
+    }
+
+    void check (int level, const Stmt& stmt)
+    {
+        if (conds) {
+            string cond;
+            for (auto& value : stmt.values)
+                cond += (cond.empty() ? "(" : " | (") + self + stmt.target + " == " + value + ")";
+            conds->push_back(stmt.values.size() > 1 ? "(" + cond + ")" : cond);
+            return;
+        }
+
+        out << pad(level) << "switch (" << stmt.target << ") {\n";
+        for (auto& value : stmt.values)
+            out << pad(level+1) << "case " << value << ":\n";
+        out << pad(level+2) << "break;\n";
+        out << pad(level+1) << "default:\n";
+        out << pad(level+2) << "throw asr::Error(std::format(\"{}: {}\", " << quote(stmt.errormsg) << ", " << stmt.target << "), " << stmt.errorcode << ");\n";
+        out << pad(level) << "}\n";
+    }
+
+    void decode (int level, const vector<Stmt>& stmts)
+    {
+        for (auto& stmt : stmts)
+        {
+            switch (stmt.kind)
+            {
+                case Stmt::S_PEEK:
+                case Stmt::S_LOAD:
+                    if (wire_types.find(stmt.type) != wire_types.end()) {
+                        auto& wt = wire_types[stmt.type];
+                        require(level, wt.size);
+                        out << pad(level) << self << stmt.target << " = rssc::" << wt.loader << "(" << at() << ");\n";
+                        if (stmt.kind == Stmt::S_LOAD)
+                            advance(level, wt.size);
                     }
+                    else {
+                        auto& type = types[stmt.type];
+                        out << pad(level) << "{\n";
+                        out << pad(level+1) << cpp_type(type.base_type) << " _value;\n";
+                        if (stmt.kind == Stmt::S_PEEK) {
+                            out << pad(level+1) << "const char *_q = _p;\n";
+                            out << pad(level+1) << "if (!" << type.name << "_load(_q, _end, _value)) " << fail << "\n";
+                        }
+                        else
+                            out << pad(level+1) << "if (!" << type.name << "_load(_p, _end, _value)) " << fail << "\n";
+                        out << pad(level+1) << stmt.target << " = _value;\n";
+                        out << pad(level) << "}\n";
+                    }
+                    break;
 
-                    active_type = Type(name, type, indent_level);
-                    types[name] = active_type;
+                case Stmt::S_SKIP:
+                    require(level, stmt.num_bytes);
+                    advance(level, stmt.num_bytes);
+                    break;
 
-                    state = 1;
+                case Stmt::S_IF:
+                    out << pad(level) << "if (" << stmt.expr << ") {\n";
+                    decode(level+1, stmt.body);
+                    out << pad(level) << "}\n";
                     break;
-                }
 
-                if (cmd == "record")
-                {
-                    target_indent_level = indent_level;
+                case Stmt::S_RET:
+                    out << pad(level) << "_value = " << stmt.expr << ";\n";
+                    out << pad(level) << "return true;\n";
                     break;
-                }
 
-                cout << "\e[91merror:\e[0m invalid keyword: \e[97m" << cmd << "\e[0m\n";
-                target_indent_level = indent_level;
-                break;
+                case Stmt::S_CHECK:
+                    check(level, stmt);
+                    break;
+            }
+        }
+    }
 
-            case 1: // local, *
-                if (cmd == "local")
-                {
-                    string name = get_word(line);
-                    if (active_type.locals.find(name) != active_type.locals.end()) {
-                        cout << "\e[91merror:\e[0m " << active_type.name << ": duplicate local variable: \e[97m" << name << "\e[0m\n";
-                        break;
+    void encode (int level, const vector<Stmt>& stmts)
+    {
+        for (auto& stmt : stmts)
+        {
+            switch (stmt.kind)
+            {
+                case Stmt::S_LOAD:
+                case Stmt::S_STORE:
+                    if (wire_types.find(stmt.type) != wire_types.end()) {
+                        auto& wt = wire_types[stmt.type];
+                        require(level, wt.size);
+                        out << pad(level) << "rssc::" << wt.storer << "(" << at() << ", " << (stmt.kind == Stmt::S_LOAD ? stmt.target : stmt.expr) << ");\n";
+                        advance(level, wt.size);
                     }
+                    else
+                        out << pad(level) << "if (!" << stmt.type << "_store(_p, _end, " << stmt.target << ")) " << fail << "\n";
+                    break;
 
-                    if (!expect_word(line, "as"))
-                        break;
+                case Stmt::S_SKIP:
+                    require(level, stmt.num_bytes);
+                    out << pad(level) << "std::memset(" << at() << ", 0, " << stmt.num_bytes << ");\n";
+                    advance(level, stmt.num_bytes);
+                    break;
 
-                    string type = get_word(line);
-                    if (base_types.find(type) == base_types.end()) {
-                        cout << "\e[91merror:\e[0m " << active_type.name << ": invalid base type: \e[97m" << type << "\e[0m\n";
-                        break;
-                    }
+                case Stmt::S_IF:
+                    out << pad(level) << "if (" << stmt.expr << ") {\n";
+                    encode(level+1, stmt.body);
+                    out << pad(level) << "}\n";
+                    break;
 
-                    active_type.locals[name] = Type(name, type, 0);
+                case Stmt::S_RET:
+                    out << pad(level) << "return true;\n";
                     break;
-                }
 
-                if (cmd == "peek")
-                {
-                }
+                case Stmt::S_CHECK:
+                    check(level, stmt);
+                    break;
+            }
+        }
+    }
+};
+
+/**
+ * Runtime helpers shared by all generated files.
+ */
+const char *runtime_code = R"(#ifndef __RSSC_RUNTIME
+#define __RSSC_RUNTIME
+
+/**
+ * Unaligned little/big endian loads and stores used by the generated codecs.
+ */
+namespace rssc
+{
+    inline uint16_t le16 (uint16_t v) { return std::endian::native == std::endian::little ? v : __builtin_bswap16(v); }
+    inline uint32_t le32 (uint32_t v) { return std::endian::native == std::endian::little ? v : __builtin_bswap32(v); }
+    inline uint16_t be16 (uint16_t v) { return std::endian::native == std::endian::big ? v : __builtin_bswap16(v); }
+    inline uint32_t be32 (uint32_t v) { return std::endian::native == std::endian::big ? v : __builtin_bswap32(v); }
+
+    inline uint16_t ld16 (const char *p) { uint16_t v; std::memcpy(&v, p, 2); return v; }
+    inline uint32_t ld32 (const char *p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+    inline int ld_u8 (const char *p) { return (unsigned char)p[0]; }
+    inline int ld_i8 (const char *p) { return (signed char)p[0]; }
+    inline int ld_u16 (const char *p) { return le16(ld16(p)); }
+    inline int ld_i16 (const char *p) { return (int16_t)le16(ld16(p)); }
+    inline int ld_u16be (const char *p) { return be16(ld16(p)); }
+    inline int ld_i16be (const char *p) { return (int16_t)be16(ld16(p)); }
+    inline int ld_u32 (const char *p) { return (int)le32(ld32(p)); }
+    inline int ld_i32 (const char *p) { return (int32_t)le32(ld32(p)); }
+    inline int ld_u32be (const char *p) { return (int)be32(ld32(p)); }
+    inline int ld_i32be (const char *p) { return (int32_t)be32(ld32(p)); }
+
+    inline void st_8 (char *p, int v) { p[0] = (char)v; }
+    inline void st_16 (char *p, int v) { uint16_t x = le16((uint16_t)v); std::memcpy(p, &x, 2); }
+    inline void st_16be (char *p, int v) { uint16_t x = be16((uint16_t)v); std::memcpy(p, &x, 2); }
+    inline void st_32 (char *p, int v) { uint32_t x = le32((uint32_t)v); std::memcpy(p, &x, 4); }
+    inline void st_32be (char *p, int v) { uint32_t x = be32((uint32_t)v); std::memcpy(p, &x, 4); }
+};
+
+#endif
+)";
+
+/**
+ * Emits the load/store functions of a type.
+ */
+void emit_type (ostream& out, const Type& type)
+{
+    Emitter e { out, false };
+    string base = cpp_type(type.base_type);
+
+    out << "/**\n";
+    out << " * Decodes a `" << type.name << "` value and advances the pointer. Returns `false` if more data is required.\n";
+    out << " */\n";
+    out << "inline bool " << type.name << "_load (const char *&_p, const char *_end, " << base << " &_value)\n";
+    out << "{\n";
+    for (auto& var : type.vars)
+        out << "    " << cpp_type(var.type) << " " << var.name << " = 0;\n";
+    if (!type.vars.empty())
+        out << "\n";
+
+    e.fail = "return false;";
+    e.decode(1, type.decode);
+    if (type.decode.empty() || type.decode.back().kind != Stmt::S_RET)
+        out << "    return true;\n";
+    out << "}\n\n";
+
+    if (!type.has_encode)
+        return;
+
+    out << "/**\n";
+    out << " * Encodes a `" << type.name << "` value and advances the pointer. Returns `false` if there is not enough space.\n";
+    out << " */\n";
+    out << "inline bool " << type.name << "_store (char *&_p, char *_end, " << base << " " << type.encode_var << ")\n";
+    out << "{\n";
+    e.encode(1, type.encode);
+    if (type.encode.empty() || type.encode.back().kind != Stmt::S_RET)
+        out << "    return true;\n";
+    out << "}\n\n";
+}
+
+/**
+ * Emits the structure and codec methods of a record.
+ */
+void emit_record (ostream& out, const Type& type)
+{
+    int required;
+    int size = fixed_size(type.decode, &required);
+    if (!size) size = -1;
+
+    int max_bytes = max(max_size(type.decode, false), max_size(type.decode, true));
+    bool has_encode = can_encode(type.decode);
+
+    out << "/**\n";
+    out << " * Record `" << type.name << "`";
+    out << (size != -1 ? " (fixed size of " + to_string(size) + " bytes).\n" : string(" (variable size).\n"));
+    out << " */\n";
+    out << "struct " << type.name << "\n";
+    out << "{\n";
+
+    for (auto& var : type.vars)
+        out << "    " << cpp_type(var.type) << " " << var.name << " = 0;\n";
+    out << "\n";
+
+    if (size != -1)
+        out << "    static constexpr int SIZE = " << size << ";\n";
+    out << "    static constexpr int MAX_SIZE = " << max(max_bytes, required) << ";\n\n";
+
+    // Decoder.
+    out << "    /**\n";
+    out << "     * Decodes the record from a contiguous block of memory. Returns the number of bytes consumed or zero if more data\n";
+    out << "     * is required. Throws `asr::Error` if a field has an invalid value.\n";
+    out << "     */\n";
+    out << "    int decode (const char *_data, int _length)\n";
+    out << "    {\n";
+
+    if (size != -1) {
+        Emitter e { out, true, 0, "return 0;" };
+        out << "        if (_length < " << required << ") return 0;\n";
+        e.decode(2, type.decode);
+        out << "        return " << size << ";\n";
+    }
+    else {
+        Emitter e { out, false, 0, "return 0;" };
+        out << "        const char *_p = _data, *_end = _data + _length;\n";
+        e.decode(2, type.decode);
+        out << "        return _p - _data;\n";
+    }
+
+    out << "    }\n\n";
+
+    // Buffer reader.
+    out << "    /**\n";
+    out << "     * Reads the record from a buffer. Returns `false` if more data is required, in which case the buffer is left untouched.\n";
+    out << "     */\n";
+    out << "    bool read (asr::Buffer *input)\n";
+    out << "    {\n";
+    out << "        char tmp[MAX_SIZE];\n";
+    out << "        int n = input->bytes_available() < MAX_SIZE ? input->bytes_available() : MAX_SIZE;\n";
+    out << "        if (input->drain(tmp, n, false) != n) return false;\n\n";
+    out << "        n = decode(tmp, n);\n";
+    out << "        if (!n) return false;\n\n";
+    out << "        input->drain(n);\n";
+    out << "        return true;\n";
+    out << "    }\n";
+
+    // Batch decoder.
+    if (options.batch)
+    {
+        out << "\n";
+        out << "    /**\n";
+        out << "     * Decodes up to `_count` consecutive records into `_output` and advances `_data` past them. Returns the number of\n";
+        out << "     * records decoded, stops at the first incomplete record. Throws `asr::Error` if a field has an invalid value, in\n";
+        out << "     * which case `_data` points to the offending record.\n";
+        out << "     */\n";
+        out << "    static int decode_batch (const char *&_data, const char *_end, " << type.name << " *_output, int _count)\n";
+        out << "    {\n";
+
+        if (size != -1)
+        {
+            vector<string> conds;
+            Emitter e { out, true, 0, "", "r.", &conds };
+
+            out << "        int n = (_end - _data" << (required > size ? " - " + to_string(required - size) : string()) << ") / SIZE;\n";
+            out << "        if (n > _count) n = _count;\n\n";
+            out << "        for (int i = 0; i < n; i++, _data += SIZE)\n";
+            out << "        {\n";
+            out << "            " << type.name << "& r = _output[i];\n";
+            e.decode(3, type.decode);
+
+            if (!conds.empty()) {
+                string valid;
+                for (auto& cond : conds)
+                    valid += (valid.empty() ? "" : " & ") + cond;
+                out << "            if (!(" << valid << "))\n";
+                out << "                r.decode(_data, SIZE); // Throws the error.\n";
+            }
+
+            out << "        }\n\n";
+            out << "        return n < 0 ? 0 : n;\n";
+        }
+        else
+        {
+            out << "        int i = 0;\n";
+            out << "        for (; i < _count; i++) {\n";
+            out << "            int n = _output[i].decode(_data, _end - _data);\n";
+            out << "            if (!n) break;\n";
+            out << "            _data += n;\n";
+            out << "        }\n\n";
+            out << "        return i;\n";
+        }
+
+        out << "    }\n";
+    }
+
+    if (has_encode)
+    {
+        // Encoder.
+        out << "\n";
+        out << "    /**\n";
+        out << "     * Encodes the record into a contiguous block of memory. Returns the number of bytes written or zero if there is\n";
+        out << "     * not enough space. Throws `asr::Error` if a field has an invalid value.\n";
+        out << "     */\n";
+        out << "    int encode (char *_data, int _length) const\n";
+        out << "    {\n";
+
+        if (size != -1) {
+            Emitter e { out, true, 0, "return 0;" };
+            out << "        if (_length < " << size << ") return 0;\n";
+            e.encode(2, type.decode);
+            out << "        return " << size << ";\n";
+        }
+        else {
+            Emitter e { out, false, 0, "return 0;" };
+            out << "        char *_p = _data, *_end = _data + _length;\n";
+            e.encode(2, type.decode);
+            out << "        return _p - _data;\n";
+        }
+
+        out << "    }\n\n";
+
+        // Buffer writer.
+        out << "    /**\n";
+        out << "     * Writes the record to a buffer (all or nothing). Returns `false` if there is not enough space.\n";
+        out << "     */\n";
+        out << "    bool write (asr::Buffer *output) const\n";
+        out << "    {\n";
+        out << "        char tmp[MAX_SIZE];\n";
+        out << "        int n = encode(tmp, MAX_SIZE);\n";
+        out << "        return n && output->write(tmp, n);\n";
+        out << "    }\n";
+    }
+
+    out << "};\n\n";
+}
+
+/**
+ * Returns the first statement that loads the specified variable.
+ */
+const Stmt *find_load (const vector<Stmt>& stmts, const string& name)
+{
+    for (auto& stmt : stmts)
+    {
+        if (stmt.kind == Stmt::S_LOAD && stmt.target == name)
+            return &stmt;
+
+        if (stmt.kind == Stmt::S_IF) {
+            auto result = find_load(stmt.body, name);
+            if (result) return result;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * Returns the first check of the specified variable.
+ */
+const Stmt *find_check (const vector<Stmt>& stmts, const string& name)
+{
+    for (auto& stmt : stmts)
+    {
+        if (stmt.kind == Stmt::S_CHECK && stmt.target == name)
+            return &stmt;
+
+        if (stmt.kind == Stmt::S_IF) {
+            auto result = find_check(stmt.body, name);
+            if (result) return result;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * Emits the random record generator used to build the benchmark corpus.
+ */
+void emit_random (ostream& out, const Type& type)
+{
+    out << "/**\n";
+    out << " * Fills a `" << type.name << "` with random values that pass all checks.\n";
+    out << " */\n";
+    out << "static void random_" << type.name << " (" << type.name << "& r)\n";
+    out << "{\n";
 
-                //peek uint8 into val
-                //if !(val & 0x80)
-                //    load uint8 into val
-                //    ret val
-                //load uint32be into val
-                //ret val
+    for (auto& var : type.vars)
+    {
+        auto check = find_check(type.decode, var.name);
+        if (check && check->values.size() == 1) {
+            out << "    r." << var.name << " = " << check->values[0] << ";\n";
+            continue;
+        }
 
+        if (check) {
+            out << "    switch (rnd() % " << check->values.size() << ") {\n";
+            for (size_t i = 0; i < check->values.size(); i++)
+                out << "        case " << i << ": r." << var.name << " = " << check->values[i] << "; break;\n";
+            out << "    }\n";
+            continue;
+        }
+
+        auto load = find_load(type.decode, var.name);
+        if (!load) continue;
+
+        // Custom types get values of random magnitude to exercise all of their branches.
+        if (wire_types.find(load->type) == wire_types.end()) {
+            out << "    r." << var.name << " = (rnd() & 0x7FFFFFFF) >> (rnd() & 31);\n";
+            continue;
+        }
+
+        bool is_signed = load->type[0] == 'i';
+        switch (wire_types[load->type].size) {
+            case 1:
+                out << "    r." << var.name << " = " << (is_signed ? "(int8_t)rnd()" : "rnd() & 0xFF") << ";\n";
+                break;
+            case 2:
+                out << "    r." << var.name << " = " << (is_signed ? "(int16_t)rnd()" : "rnd() & 0xFFFF") << ";\n";
+                break;
+            default:
+                out << "    r." << var.name << " = rnd();\n";
                 break;
         }
     }
 
+    out << "}\n\n";
+}
+
+/**
+ * Emits the benchmark of a record: builds a random corpus, verifies the round-trip and measures the codec throughput.
+ */
+void emit_record_bench (ostream& out, const Type& type)
+{
+    const string& T = type.name;
+
+    emit_random(out, type);
+
+    out << "/**\n";
+    out << " * Benchmarks the `" << T << "` codec. Returns `false` if the round-trip check fails.\n";
+    out << " */\n";
+    out << "static bool bench_" << T << " (int num_frames, int rounds)\n";
+    out << "{\n";
+    out << "    vector<char> corpus ((size_t)num_frames * " << T << "::MAX_SIZE);\n";
+    out << "    vector<char> copy (corpus.size());\n";
+    out << "    vector<" << T << "> records (num_frames);\n\n";
+
+    out << "    char *p = corpus.data();\n";
+    out << "    for (auto& r : records) {\n";
+    out << "        random_" << T << "(r);\n";
+    out << "        p += r.encode(p, " << T << "::MAX_SIZE);\n";
+    out << "    }\n\n";
+    out << "    long length = p - corpus.data();\n";
+    out << "    const char *begin = corpus.data(), *end = begin + length;\n\n";
+
+    out << "    try\n";
+    out << "    {\n";
+    out << "        // Round-trip check.\n";
+    out << "        const char *q = begin;\n";
+    out << "        p = copy.data();\n";
+    out << "        for (auto& r : records) {\n";
+    out << "            q += r.decode(q, end - q);\n";
+    out << "            p += r.encode(p, " << T << "::MAX_SIZE);\n";
+    out << "        }\n\n";
+    out << "        if (q != end || memcmp(begin, copy.data(), length) != 0) {\n";
+    out << "            printf(\"%-24s \\e[91mround-trip mismatch\\e[0m\\n\", \"" << T << "\");\n";
+    out << "            return false;\n";
+    out << "        }\n\n";
+
+    out << "        auto t0 = chrono::steady_clock::now();\n";
+    out << "        for (int k = 0; k < rounds; k++) {\n";
+    out << "            q = begin;\n";
+    out << "            for (auto& r : records)\n";
+    out << "                q += r.decode(q, end - q);\n";
+    out << "        }\n";
+    out << "        auto t1 = chrono::steady_clock::now();\n";
+    out << "        report(\"" << T << "\", \"decode\", t1 - t0, (double)num_frames * rounds, (double)length * rounds);\n\n";
+
+    if (options.batch) {
+        out << "        t0 = chrono::steady_clock::now();\n";
+        out << "        for (int k = 0; k < rounds; k++) {\n";
+        out << "            q = begin;\n";
+        out << "            " << T << "::decode_batch(q, end, records.data(), num_frames);\n";
+        out << "        }\n";
+        out << "        t1 = chrono::steady_clock::now();\n";
+        out << "        report(\"" << T << "\", \"decode_batch\", t1 - t0, (double)num_frames * rounds, (double)length * rounds);\n\n";
+    }
+
+    out << "        t0 = chrono::steady_clock::now();\n";
+    out << "        for (int k = 0; k < rounds; k++) {\n";
+    out << "            p = copy.data();\n";
+    out << "            for (auto& r : records)\n";
+    out << "                p += r.encode(p, " << T << "::MAX_SIZE);\n";
+    out << "        }\n";
+    out << "        t1 = chrono::steady_clock::now();\n";
+    out << "        report(\"" << T << "\", \"encode\", t1 - t0, (double)num_frames * rounds, (double)length * rounds);\n";
+    out << "    }\n";
+    out << "    catch (asr::Error& e) {\n";
+    out << "        printf(\"%-24s \\e[91m%s\\e[0m\\n\", \"" << T << "\", e.message());\n";
+    out << "        return false;\n";
+    out << "    }\n\n";
+
+    out << "    sink = sink + (int)copy[length - 1];\n";
+    out << "    return true;\n";
+    out << "}\n\n";
+}
+
+/**
+ * Runtime of the generated benchmarks.
+ */
+const char *bench_runtime_code = R"(
+using namespace std;
+
+/**
+ * Deterministic pseudo-random generator (xorshift32) used to build the corpus.
+ */
+static uint32_t seed = 0x9E3779B9;
+
+static uint32_t rnd() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/**
+ * Keeps the results alive.
+ */
+static volatile int sink = 0;
+
+/**
+ * Prints the throughput of a measurement.
+ */
+static void report (const char *record, const char *name, chrono::steady_clock::duration elapsed, double num_frames, double num_bytes)
+{
+    double ns = chrono::duration<double, nano>(elapsed).count();
+    printf("%-24s %-14s %8.2f ns/frame %10.2f Mframes/s %10.2f MB/s\n", record, name,
+        ns / num_frames, num_frames * 1e3 / ns, num_bytes * 1e3 / ns);
+}
+
+)";
+
+/**
+ * Emits a standalone benchmark program for all records of the schema.
+ */
+void emit_bench (ostream& out, const string& schema_path, const string& header)
+{
+    out << "// Generated by rssc from " << schema_path << ", do not edit.\n";
+    out << "#include \"" << header << "\"\n";
+    out << "#include <chrono>\n";
+    out << "#include <cstdio>\n";
+    out << "#include <cstdlib>\n";
+    out << "#include <vector>\n";
+    out << bench_runtime_code;
+
+    vector<string> records;
+    for (auto& name : type_order)
+    {
+        auto& type = types[name];
+        if (!type.is_record || !can_encode(type.decode))
+            continue;
+
+        emit_record_bench(out, type);
+        records.push_back(name);
+    }
+
+    out << "/**\n";
+    out << " * Usage: <program> [num_frames] [rounds]\n";
+    out << " */\n";
+    out << "int main (int argc, const char *argv[])\n";
+    out << "{\n";
+    out << "    int num_frames = argc > 1 ? atoi(argv[1]) : 100000;\n";
+    out << "    int rounds = argc > 2 ? atoi(argv[2]) : 20;\n";
+    out << "    bool ok = true;\n\n";
+    out << "    if (num_frames < 1 || rounds < 1) {\n";
+    out << "        printf(\"Usage: %s [num_frames] [rounds]\\n\", argv[0]);\n";
+    out << "        return 1;\n";
+    out << "    }\n\n";
+    for (auto& name : records)
+        out << "    ok = bench_" << name << "(num_frames, rounds) && ok;\n";
+    out << "\n";
+    out << "    return ok ? 0 : 1;\n";
+    out << "}\n";
+}
+
+/**
+ * Returns the include guard for the output file.
+ */
+string include_guard (const string& path)
+{
+    auto pos = path.find_last_of("/\\");
+    string name = pos != string::npos ? path.substr(pos+1) : path;
+
+    string guard = "__RSSC_";
+    for (char c : name)
+        guard += isalnum(c) ? toupper(c) : '_';
+    return guard;
+}
+
+/**
+ */
+int _main (const char *schema_path, const char *output_path)
+{
+    ifstream schema(schema_path);
+    if (!schema) {
+        cout << "\e[91merror:\e[0m failed to open schema file: \e[97m" << schema_path << "\e[0m\n";
+        return 1;
+    }
+
+    for (auto& line : parse_lines(schema)) {
+        if (line.indent_level != 0) {
+            error(line.number) << "unexpected indentation\n";
+            continue;
+        }
+        parse_type(line);
+    }
+
+    if (num_errors) {
+        cout << "\e[91m" << num_errors << " error(s) found, no output generated\e[0m\n";
+        return 1;
+    }
+
+    stringstream code;
+    string guard = include_guard(output_path);
+
+    code << "// Generated by rssc from " << schema_path << ", do not edit.\n";
+    code << "#ifndef " << guard << "\n";
+    code << "#define " << guard << "\n\n";
+    code << "#include <asr/buffer>\n";
+    code << "#include <asr/error>\n";
+    code << "#include <bit>\n";
+    code << "#include <cstring>\n";
+    code << "#include <format>\n\n";
+    code << runtime_code << "\n";
+
+    for (auto& name : type_order)
+    {
+        auto& type = types[name];
+        if (type.is_record)
+            emit_record(code, type);
+        else
+            emit_type(code, type);
+    }
+
+    code << "#endif\n";
+
+    ofstream output(output_path);
+    if (!output) {
+        cout << "\e[91merror:\e[0m failed to open output file: \e[97m" << output_path << "\e[0m\n";
+        return 1;
+    }
+
+    output << code.str();
+
+    if (!options.bench_path.empty())
+    {
+        ofstream bench(options.bench_path);
+        if (!bench) {
+            cout << "\e[91merror:\e[0m failed to open benchmark file: \e[97m" << options.bench_path << "\e[0m\n";
+            return 1;
+        }
+
+        // Include the header by name when both files live in the same folder.
+        string header = output_path;
+        auto a = header.find_last_of("/\\"), b = options.bench_path.find_last_of("/\\");
+        if (header.substr(0, a == string::npos ? 0 : a) == options.bench_path.substr(0, b == string::npos ? 0 : b))
+            header = header.substr(a == string::npos ? 0 : a+1);
+
+        emit_bench(bench, schema_path, header);
+    }
+
     return 0;
 }
 
@@ -200,12 +1325,30 @@ int main (int argc, const char *argv[])
 {
     auto n = asr::memblocks;
 
-    if (argc < 3) {
-        cout << "Usage: rssc <schema-file> <output-file>\n";
+    vector<const char *> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--batch"))
+            options.batch = true;
+        else if (!strcmp(argv[i], "--bench") && i+1 < argc)
+            options.bench_path = argv[++i];
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() != 2) {
+        cout << "Usage: rssc [--batch] [--bench <benchmark-file>] <schema-file> <output-file>\n";
+        cout << "  --batch   Emit a `decode_batch` function for each record.\n";
+        cout << "  --bench   Emit a benchmark program with a random corpus generator for each record.\n";
         return 0;
     }
 
-    int exitcode = _main(argc, argv);
+    int exitcode = _main(args[0], args[1]);
+    vector<const char *>().swap(args);
+
+    unordered_map<string, Type>().swap(types);
+    vector<string>().swap(type_order);
+    string().swap(options.bench_path);
 
     asr::refs::shutdown();
     if (asr::memblocks != n) {